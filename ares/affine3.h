@@ -0,0 +1,300 @@
+#ifndef __ARES_AFFINE3_H__
+#define __ARES_AFFINE3_H__
+
+#include "cs3.h"
+#include "matrix.h"
+#include "simd.h"
+#include "vec3.h"
+
+#include <cassert>
+#include <concepts>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+
+namespace ares
+{
+
+/**
+ * @brief Compact affine transform, a row major 3x4 float matrix whose implicit last row is
+ * 0 0 0 1. Takes 48 bytes instead of the 128 of a dmatrix, for transforms stored or streamed per
+ * object or instance
+ */
+struct Affine3
+{
+  /**
+   * @brief Make transform from cs
+   * @tparam T Floating point type of the cs
+   * @param cs Coordinate system to use
+   * @return Transform
+   */
+  template <std::floating_point T>
+  static constexpr Affine3 make_from(const Cs3<T>& cs);
+
+  /**
+   * @brief Make transform from a matrix, its last row is dropped
+   * @tparam T Floating point type of the matrix
+   * @param mx Matrix to convert, must be affine
+   * @return Transform
+   */
+  template <std::floating_point T>
+  static constexpr Affine3 make_from(const Matrix<T>& mx);
+
+  /**
+   * @brief Compose a transform with several transforms, e.g. a parent transform with its children
+   * transforms, the SIMD kernel keeps the left transform in registers for all compositions
+   * @param af Left transform
+   * @param afs Right transforms
+   * @param res Resulting af * afs[i] transforms, same size as afs, may be afs
+   */
+  static void compose(const Affine3& af, std::span<const Affine3> afs, std::span<Affine3> res);
+
+  /**
+   * @brief Composition operator, the result applies af first then this transform
+   * @param af Transform by which to multiply
+   * @return Resulting transform
+   */
+  constexpr Affine3 operator*(const Affine3& af) const;
+
+  /**
+   * @brief Composition assignment operator
+   * @param af Transform by which to multiply
+   */
+  constexpr void operator*=(const Affine3& af);
+
+  /**
+   * @brief Convert to a 4x4 matrix
+   * @tparam T Floating point type of the matrix
+   * @return Matrix
+   */
+  template <std::floating_point T>
+  constexpr Matrix<T> to_matrix() const;
+
+  /**
+   * @brief Convert to a cs, the transform must be rigid
+   * @tparam T Floating point type of the cs
+   * @return Coordinate system
+   */
+  template <std::floating_point T>
+  constexpr Cs3<T> to_cs() const;
+
+  /**
+   * @brief Make the inverse transform, only the 3x3 linear part is inverted
+   * @return Resulting transform
+   */
+  constexpr Affine3 make_inverse() const;
+
+  /**
+   * @brief Make the inverse of a rigid transform, a rotation and a translation, the rotation is
+   * transposed and the translation rotated back
+   * @return Resulting transform
+   */
+  constexpr Affine3 make_inverse_rigid() const;
+
+  /**
+   * @brief Set the provided point as origin
+   * @param origin Origin to set
+   */
+  constexpr void set_origin(const fvec3& origin);
+
+  /**
+   * @brief Transform the provided vector by this transform
+   * @param v Vector to transform
+   * @return Transformed vector
+   */
+  constexpr fvec3 transform_v(const fvec3& v) const;
+
+  /**
+   * @brief Transform the provided point by this transform
+   * @param p Point to transform
+   * @return Transformed point
+   */
+  constexpr fvec3 transform_p(const fvec3& p) const;
+
+  // data count
+  static const int count{12};
+  // transform rows, each made of 3 linear values and a translation, identity by default
+  float data[count] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0};
+};
+
+
+
+template <std::floating_point T>
+constexpr Affine3 Affine3::make_from(const Cs3<T>& cs)
+{
+  return {
+    static_cast<float>(cs.x_axis.x),
+    static_cast<float>(cs.y_axis.x),
+    static_cast<float>(cs.z_axis.x),
+    static_cast<float>(cs.origin.x), // 1st row
+    static_cast<float>(cs.x_axis.y),
+    static_cast<float>(cs.y_axis.y),
+    static_cast<float>(cs.z_axis.y),
+    static_cast<float>(cs.origin.y), // 2nd row
+    static_cast<float>(cs.x_axis.z),
+    static_cast<float>(cs.y_axis.z),
+    static_cast<float>(cs.z_axis.z),
+    static_cast<float>(cs.origin.z)}; // 3rd row
+}
+
+
+
+template <std::floating_point T>
+constexpr Affine3 Affine3::make_from(const Matrix<T>& mx)
+{
+  // the matrix is column major
+  Affine3 af;
+  for (int r = 0; r < 3; ++r)
+  {
+    for (int c = 0; c < 4; ++c)
+    {
+      af.data[4 * r + c] = static_cast<float>(mx[4 * c + r]);
+    }
+  }
+  return af;
+}
+
+
+
+inline void Affine3::compose(
+  const Affine3& af, std::span<const Affine3> afs, std::span<Affine3> res)
+{
+  assert(afs.size() == res.size());
+  static_assert(sizeof(Affine3) == count * sizeof(float));
+  if (afs.empty())
+  {
+    return;
+  }
+  simd::compose_affines(
+    af.data, afs.data()->data, res.data()->data, static_cast<int32_t>(afs.size()));
+}
+
+
+
+constexpr Affine3 Affine3::operator*(const Affine3& af) const
+{
+  Affine3 res;
+  if (!std::is_constant_evaluated())
+  {
+    simd::compose_affines(data, af.data, res.data, 1);
+    return res;
+  }
+
+  for (int r = 0; r < 3; ++r)
+  {
+    const float* row = data + 4 * r;
+    for (int c = 0; c < 4; ++c)
+    {
+      res.data[4 * r + c] = row[0] * af.data[c] + row[1] * af.data[4 + c]
+                          + row[2] * af.data[8 + c] + (3 == c ? row[3] : 0.0f);
+    }
+  }
+  return res;
+}
+
+
+
+constexpr void Affine3::operator*=(const Affine3& af)
+{
+  *this = *this * af;
+}
+
+
+
+template <std::floating_point T>
+constexpr Matrix<T> Affine3::to_matrix() const
+{
+  Matrix<T> mx;
+  for (int r = 0; r < 3; ++r)
+  {
+    for (int c = 0; c < 4; ++c)
+    {
+      mx[4 * c + r] = static_cast<T>(data[4 * r + c]);
+    }
+  }
+  mx[15] = 1;
+  return mx;
+}
+
+
+
+template <std::floating_point T>
+constexpr Cs3<T> Affine3::to_cs() const
+{
+  return {
+    .origin = {.x = data[3], .y = data[7], .z = data[11]},
+    .x_axis = {.x = data[0], .y = data[4], .z = data[8]},
+    .y_axis = {.x = data[1], .y = data[5], .z = data[9]},
+    .z_axis = {.x = data[2], .y = data[6], .z = data[10]}};
+}
+
+
+
+constexpr Affine3 Affine3::make_inverse() const
+{
+  // the inverse linear part columns are the cross products of the other 2 rows over the
+  // determinant
+  const fvec3 row0{.x = data[0], .y = data[1], .z = data[2]};
+  const fvec3 row1{.x = data[4], .y = data[5], .z = data[6]};
+  const fvec3 row2{.x = data[8], .y = data[9], .z = data[10]};
+  const fvec3 origin{.x = data[3], .y = data[7], .z = data[11]};
+  const float inv_det = 1 / row0.dot(row1 * row2);
+  const fvec3 col0 = row1 * row2 * inv_det;
+  const fvec3 col1 = row2 * row0 * inv_det;
+  const fvec3 col2 = row0 * row1 * inv_det;
+  const fvec3 inv_row0{.x = col0.x, .y = col1.x, .z = col2.x};
+  const fvec3 inv_row1{.x = col0.y, .y = col1.y, .z = col2.y};
+  const fvec3 inv_row2{.x = col0.z, .y = col1.z, .z = col2.z};
+  return {
+    inv_row0.x, inv_row0.y, inv_row0.z, -inv_row0.dot(origin), // 1st row
+    inv_row1.x, inv_row1.y, inv_row1.z, -inv_row1.dot(origin), // 2nd row
+    inv_row2.x, inv_row2.y, inv_row2.z, -inv_row2.dot(origin)}; // 3rd row
+}
+
+
+
+constexpr Affine3 Affine3::make_inverse_rigid() const
+{
+  // the inverse rotation rows are the rotation columns
+  const fvec3 x_axis{.x = data[0], .y = data[4], .z = data[8]};
+  const fvec3 y_axis{.x = data[1], .y = data[5], .z = data[9]};
+  const fvec3 z_axis{.x = data[2], .y = data[6], .z = data[10]};
+  const fvec3 origin{.x = data[3], .y = data[7], .z = data[11]};
+  return {
+    x_axis.x, x_axis.y, x_axis.z, -x_axis.dot(origin), // 1st row
+    y_axis.x, y_axis.y, y_axis.z, -y_axis.dot(origin), // 2nd row
+    z_axis.x, z_axis.y, z_axis.z, -z_axis.dot(origin)}; // 3rd row
+}
+
+
+
+constexpr void Affine3::set_origin(const fvec3& origin)
+{
+  data[3] = origin.x;
+  data[7] = origin.y;
+  data[11] = origin.z;
+}
+
+
+
+constexpr fvec3 Affine3::transform_v(const fvec3& v) const
+{
+  return {
+    .x = data[0] * v.x + data[1] * v.y + data[2] * v.z,
+    .y = data[4] * v.x + data[5] * v.y + data[6] * v.z,
+    .z = data[8] * v.x + data[9] * v.y + data[10] * v.z};
+}
+
+
+
+constexpr fvec3 Affine3::transform_p(const fvec3& p) const
+{
+  return {
+    .x = data[0] * p.x + data[1] * p.y + data[2] * p.z + data[3],
+    .y = data[4] * p.x + data[5] * p.y + data[6] * p.z + data[7],
+    .z = data[8] * p.x + data[9] * p.y + data[10] * p.z + data[11]};
+}
+
+} // namespace ares
+
+#endif //__ARES_AFFINE3_H__
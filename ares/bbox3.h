@@ -1,6 +1,8 @@
 #ifndef __ARES_BBOX3_H__
 #define __ARES_BBOX3_H__
 
+#include "concepts.h"
+#include "matrix.h"
 #include "vec3.h"
 
 #include <initializer_list>
@@ -10,123 +12,158 @@
 namespace ares
 {
 
-struct Bbox3
+template <std::floating_point T>
+struct Bbox3_t;
+
+using Bbox3 = Bbox3_t<double>;
+using Bbox3f = Bbox3_t<float>;
+
+/**
+ * @brief Axis aligned bounding box, empty when its min corner is past its max corner
+ * @tparam T Floating point type to use
+ */
+template <std::floating_point T>
+struct Bbox3_t
 {
   /**
    * @brief Make a bounding box from points
    * @param points Points to use
    * @return Bounding box
    */
-  static constexpr Bbox3 make_from(std::initializer_list<const dvec3> points);
+  static constexpr Bbox3_t make_from(std::initializer_list<const Vec3<T>> points);
 
   /**
    * @brief Make a bounding box from points
    * @param points Points to use
    * @return Bounding box
    */
-  static constexpr Bbox3 make_from(std::span<const dvec3> points);
+  static constexpr Bbox3_t make_from(std::span<const Vec3<T>> points);
 
   /**
    * @brief Extend bounding box with the provided point
    * @param pt Point to use
    */
-  constexpr void extend(const dvec3& pt);
+  constexpr void extend(const Vec3<T>& pt);
 
   /**
    * @brief Extend bounding box with the provided points
    * @param points Points to use
    */
-  constexpr void extend(std::span<const dvec3> points);
+  constexpr void extend(std::initializer_list<const Vec3<T>> points);
+
+  /**
+   * @brief Extend bounding box with the provided points
+   * @param points Points to use
+   */
+  constexpr void extend(std::span<const Vec3<T>> points);
+
+  /**
+   * @brief Extend bounding box with the provided bounding box
+   * @param bbox Bounding box to use, nothing changes if empty
+   */
+  constexpr void extend(const Bbox3_t& bbox);
 
   /**
    * @brief Compute the bounding box center
    * @return Center
    */
-  constexpr dvec3 center() const;
+  constexpr Vec3<T> center() const;
+
+  /**
+   * @brief Compute the bounding box of this bounding box transformed by a matrix, Arvo's method:
+   * the center is transformed as a point and the half extents by the absolute values of the matrix
+   * rotation and scale part, instead of transforming all 8 corners
+   * @param mat Matrix to use, affine
+   * @return Transformed bounding box, empty if this bounding box is empty
+   */
+  constexpr Bbox3_t transformed(const Matrix<T>& mat) const;
 
   /**
    * @brief Compute the min and max corners along the provided vector direction
    * @param dir Direction to use
    * @return Min and max corners along direction
    */
-  constexpr std::pair<dvec3, dvec3> corners(const dvec3& dir) const;
+  constexpr std::pair<Vec3<T>, Vec3<T>> corners(const Vec3<T>& dir) const;
 
   /**
    * @brief Compute the min corner along the provided vector direction
    * @param dir Direction to use
    * @return Min corner along direction
    */
-  constexpr dvec3 min_corner(const dvec3& dir) const;
+  constexpr Vec3<T> min_corner(const Vec3<T>& dir) const;
 
   /**
    * @brief Compute the max corner along the provided vector direction
    * @param dir Direction to use
    * @return Max corner along direction
    */
-  constexpr dvec3 max_corner(const dvec3& dir) const;
+  constexpr Vec3<T> max_corner(const Vec3<T>& dir) const;
 
   /**
    * @brief Check if this bounding box contains the provided point
    * @param pt Point to use
    * @return Result of check
    */
-  constexpr bool contains(const dvec3& pt) const;
+  constexpr bool contains(const Vec3<T>& pt) const;
 
   /**
    * @brief Check if this bounding box intersects the provided bounding box
    * @param bbox Bounding box to use
    * @return Result of check
    */
-  constexpr bool intersects(const Bbox3& bbox) const;
+  constexpr bool intersects(const Bbox3_t& bbox) const;
 
   /**
    * @brief Compute the closest point on/in the bounding box to the provided point
    * @param pt Point to use
    * @return Closest point
    */
-  constexpr dvec3 closest(const dvec3& pt) const;
+  constexpr Vec3<T> closest(const Vec3<T>& pt) const;
 
   /**
    * @brief Compute the farthest point on the bounding box to the provided point
    * @param pt Point to use
    * @return Farthest point
    */
-  constexpr dvec3 farthest(const dvec3& pt) const;
+  constexpr Vec3<T> farthest(const Vec3<T>& pt) const;
 
   // min corner of the bounding box
-  dvec3 min{
-    .x = std::numeric_limits<double>::max(),
-    .y = std::numeric_limits<double>::max(),
-    .z = std::numeric_limits<double>::max()};
+  Vec3<T> min{
+    .x = std::numeric_limits<T>::max(),
+    .y = std::numeric_limits<T>::max(),
+    .z = std::numeric_limits<T>::max()};
 
   // max corner of the bounding box
-  dvec3 max{
-    .x = std::numeric_limits<double>::lowest(),
-    .y = std::numeric_limits<double>::lowest(),
-    .z = std::numeric_limits<double>::lowest()};
+  Vec3<T> max{
+    .x = std::numeric_limits<T>::lowest(),
+    .y = std::numeric_limits<T>::lowest(),
+    .z = std::numeric_limits<T>::lowest()};
 };
 
 
 
-inline constexpr Bbox3 Bbox3::make_from(std::initializer_list<const dvec3> points)
+template <std::floating_point T>
+constexpr Bbox3_t<T> Bbox3_t<T>::make_from(std::initializer_list<const Vec3<T>> points)
 {
-  Bbox3 bbox;
+  Bbox3_t bbox;
   bbox.extend(points);
   return bbox;
 }
 
 
 
-inline constexpr Bbox3 Bbox3::make_from(std::span<const dvec3> points)
+template <std::floating_point T>
+constexpr Bbox3_t<T> Bbox3_t<T>::make_from(std::span<const Vec3<T>> points)
 {
-  Bbox3 bbox;
+  Bbox3_t bbox;
   bbox.extend(points);
   return bbox;
 }
 
 
 
-inline constexpr void Bbox3::extend(const dvec3& pt)
+template <std::floating_point T>
+constexpr void Bbox3_t<T>::extend(const Vec3<T>& pt)
 {
   min.x = std::min(min.x, pt.x);
   min.y = std::min(min.y, pt.y);
@@ -138,7 +175,8 @@ inline constexpr void Bbox3::extend(const dvec3& pt)
 
 
 
-inline constexpr void Bbox3::extend(std::span<const dvec3> points)
+template <std::floating_point T>
+constexpr void Bbox3_t<T>::extend(std::initializer_list<const Vec3<T>> points)
 {
   for (const auto& pt : points)
   {
@@ -148,14 +186,60 @@ inline constexpr void Bbox3::extend(std::span<const dvec3> points)
 
 
 
-inline constexpr dvec3 Bbox3::center() const
+template <std::floating_point T>
+constexpr void Bbox3_t<T>::extend(std::span<const Vec3<T>> points)
+{
+  for (const auto& pt : points)
+  {
+    extend(pt);
+  }
+}
+
+
+
+template <std::floating_point T>
+constexpr void Bbox3_t<T>::extend(const Bbox3_t& bbox)
+{
+  min.x = std::min(min.x, bbox.min.x);
+  min.y = std::min(min.y, bbox.min.y);
+  min.z = std::min(min.z, bbox.min.z);
+  max.x = std::max(max.x, bbox.max.x);
+  max.y = std::max(max.y, bbox.max.y);
+  max.z = std::max(max.z, bbox.max.z);
+}
+
+
+
+template <std::floating_point T>
+constexpr Vec3<T> Bbox3_t<T>::center() const
 {
   return (min + max) / 2;
 }
 
 
 
-inline constexpr std::pair<dvec3, dvec3> Bbox3::corners(const dvec3& dir) const
+template <std::floating_point T>
+constexpr Bbox3_t<T> Bbox3_t<T>::transformed(const Matrix<T>& mat) const
+{
+  if (max.x < min.x)
+  {
+    return *this;
+  }
+
+  const auto abs = [](T a) { return a < 0 ? -a : a; };
+  const Vec3<T> ext = (max - min) / 2;
+  const Vec3<T> wcs_center = mat.transform_p(center());
+  const Vec3<T> wcs_ext{
+    .x = abs(mat[0]) * ext.x + abs(mat[4]) * ext.y + abs(mat[8]) * ext.z,
+    .y = abs(mat[1]) * ext.x + abs(mat[5]) * ext.y + abs(mat[9]) * ext.z,
+    .z = abs(mat[2]) * ext.x + abs(mat[6]) * ext.y + abs(mat[10]) * ext.z};
+  return {.min = wcs_center - wcs_ext, .max = wcs_center + wcs_ext};
+}
+
+
+
+template <std::floating_point T>
+constexpr std::pair<Vec3<T>, Vec3<T>> Bbox3_t<T>::corners(const Vec3<T>& dir) const
 {
   const auto cx = dir.x < 0 ? std::pair{max.x, min.x} : std::pair{min.x, max.x};
   const auto cy = dir.y < 0 ? std::pair{max.y, min.y} : std::pair{min.y, max.y};
@@ -167,7 +251,8 @@ inline constexpr std::pair<dvec3, dvec3> Bbox3::corners(const dvec3& dir) const
 
 
 
-inline constexpr dvec3 Bbox3::min_corner(const dvec3& dir) const
+template <std::floating_point T>
+constexpr Vec3<T> Bbox3_t<T>::min_corner(const Vec3<T>& dir) const
 {
   const auto cx = dir.x < 0 ? max.x : min.x;
   const auto cy = dir.y < 0 ? max.y : min.y;
@@ -177,7 +262,8 @@ inline constexpr dvec3 Bbox3::min_corner(const dvec3& dir) const
 
 
 
-inline constexpr dvec3 Bbox3::max_corner(const dvec3& dir) const
+template <std::floating_point T>
+constexpr Vec3<T> Bbox3_t<T>::max_corner(const Vec3<T>& dir) const
 {
   const auto cx = dir.x < 0 ? min.x : max.x;
   const auto cy = dir.y < 0 ? min.y : max.y;
@@ -187,7 +273,8 @@ inline constexpr dvec3 Bbox3::max_corner(const dvec3& dir) const
 
 
 
-inline constexpr bool Bbox3::contains(const dvec3& pt) const
+template <std::floating_point T>
+constexpr bool Bbox3_t<T>::contains(const Vec3<T>& pt) const
 {
   return pt.x >= min.x && pt.y >= min.y && pt.z >= min.z && pt.x <= max.x && pt.y <= max.y
       && pt.z <= max.z;
@@ -195,7 +282,8 @@ inline constexpr bool Bbox3::contains(const dvec3& pt) const
 
 
 
-inline constexpr bool Bbox3::intersects(const Bbox3& bbox) const
+template <std::floating_point T>
+constexpr bool Bbox3_t<T>::intersects(const Bbox3_t& bbox) const
 {
   return bbox.min.x <= max.x && bbox.max.x >= min.x && bbox.min.y <= max.y && bbox.max.y >= min.y
       && bbox.min.z <= max.z && bbox.max.z >= min.z;
@@ -203,30 +291,32 @@ inline constexpr bool Bbox3::intersects(const Bbox3& bbox) const
 
 
 
-inline constexpr dvec3 Bbox3::closest(const dvec3& pt) const
+template <std::floating_point T>
+constexpr Vec3<T> Bbox3_t<T>::closest(const Vec3<T>& pt) const
 {
-  const double x = pt.x < min.x ? min.x : pt.x > max.x ? max.x : pt.x;
-  const double y = pt.y < min.y ? min.y : pt.y > max.y ? max.y : pt.y;
-  const double z = pt.z < min.z ? min.z : pt.z > max.z ? max.z : pt.z;
+  const T x = pt.x < min.x ? min.x : pt.x > max.x ? max.x : pt.x;
+  const T y = pt.y < min.y ? min.y : pt.y > max.y ? max.y : pt.y;
+  const T z = pt.z < min.z ? min.z : pt.z > max.z ? max.z : pt.z;
   return {.x = x, .y = y, .z = z};
 }
 
 
 
-inline constexpr dvec3 Bbox3::farthest(const dvec3& pt) const
+template <std::floating_point T>
+constexpr Vec3<T> Bbox3_t<T>::farthest(const Vec3<T>& pt) const
 {
-  const double x = pt.x < min.x                ? max.x
-                 : pt.x > max.x                ? min.x
-                 : pt.x - min.x > max.x - pt.x ? min.x
-                                               : max.x;
-  const double y = pt.y < min.y                ? max.y
-                 : pt.y > max.y                ? min.y
-                 : pt.y - min.y > max.y - pt.y ? min.y
-                                               : max.y;
-  const double z = pt.z < min.z                ? max.z
-                 : pt.z > max.z                ? min.z
-                 : pt.z - min.z > max.z - pt.z ? min.z
-                                               : max.z;
+  const T x = pt.x < min.x                ? max.x
+            : pt.x > max.x                ? min.x
+            : pt.x - min.x > max.x - pt.x ? min.x
+                                          : max.x;
+  const T y = pt.y < min.y                ? max.y
+            : pt.y > max.y                ? min.y
+            : pt.y - min.y > max.y - pt.y ? min.y
+                                          : max.y;
+  const T z = pt.z < min.z                ? max.z
+            : pt.z > max.z                ? min.z
+            : pt.z - min.z > max.z - pt.z ? min.z
+                                          : max.z;
   return {.x = x, .y = y, .z = z};
 }
 
@@ -0,0 +1,208 @@
+#ifndef __ARES_BBOX3_SOA_H__
+#define __ARES_BBOX3_SOA_H__
+
+#include "bbox3.h"
+#include "matrix.h"
+#include "simd.h"
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace ares
+{
+
+/**
+ * @brief Bounding boxes stored as structure of arrays, one contiguous array per corner coordinate,
+ * so that batch algorithms can stream over them and process several boxes per SIMD instruction
+ */
+struct Bbox3_soa
+{
+  /**
+   * @brief Get the number of boxes
+   * @return Number of boxes
+   */
+  size_t size() const;
+
+  /**
+   * @brief Check if there are no boxes
+   * @return Result of check
+   */
+  bool empty() const;
+
+  /**
+   * @brief Change the number of boxes, new boxes are empty
+   * @param count Number of boxes
+   */
+  void resize(size_t count);
+
+  /**
+   * @brief Remove all boxes
+   */
+  void clear();
+
+  /**
+   * @brief Add a box at the end
+   * @param box Box to add
+   */
+  void push_back(const Bbox3& box);
+
+  /**
+   * @brief Set the box at the provided index
+   * @param index Box index
+   * @param box Box to use
+   */
+  void set(size_t index, const Bbox3& box);
+
+  /**
+   * @brief Get the box at the provided index
+   * @param index Box index
+   * @return Box
+   */
+  Bbox3 get(size_t index) const;
+
+  // min corners x coordinates
+  std::vector<double> min_x;
+  // min corners y coordinates
+  std::vector<double> min_y;
+  // min corners z coordinates
+  std::vector<double> min_z;
+  // max corners x coordinates
+  std::vector<double> max_x;
+  // max corners y coordinates
+  std::vector<double> max_y;
+  // max corners z coordinates
+  std::vector<double> max_z;
+};
+
+/**
+ * @brief Transform bounding boxes by matrices with Arvo's method, see Bbox3::transformed. Each box
+ * is transformed with SIMD packs holding the matrix rows
+ * @param boxes Bounding boxes to transform
+ * @param mats Matrices to use, affine, one per box
+ * @param result Transformed bounding boxes, resized to the boxes count, can be the same object as
+ * boxes, empty boxes stay empty
+ */
+void transform(const Bbox3_soa& boxes, std::span<const dmatrix> mats, Bbox3_soa& result);
+
+
+
+inline size_t Bbox3_soa::size() const
+{
+  return min_x.size();
+}
+
+
+
+inline bool Bbox3_soa::empty() const
+{
+  return min_x.empty();
+}
+
+
+
+inline void Bbox3_soa::resize(size_t count)
+{
+  const Bbox3 empty;
+  min_x.resize(count, empty.min.x);
+  min_y.resize(count, empty.min.y);
+  min_z.resize(count, empty.min.z);
+  max_x.resize(count, empty.max.x);
+  max_y.resize(count, empty.max.y);
+  max_z.resize(count, empty.max.z);
+}
+
+
+
+inline void Bbox3_soa::clear()
+{
+  resize(0);
+}
+
+
+
+inline void Bbox3_soa::push_back(const Bbox3& box)
+{
+  min_x.push_back(box.min.x);
+  min_y.push_back(box.min.y);
+  min_z.push_back(box.min.z);
+  max_x.push_back(box.max.x);
+  max_y.push_back(box.max.y);
+  max_z.push_back(box.max.z);
+}
+
+
+
+inline void Bbox3_soa::set(size_t index, const Bbox3& box)
+{
+  min_x[index] = box.min.x;
+  min_y[index] = box.min.y;
+  min_z[index] = box.min.z;
+  max_x[index] = box.max.x;
+  max_y[index] = box.max.y;
+  max_z[index] = box.max.z;
+}
+
+
+
+inline Bbox3 Bbox3_soa::get(size_t index) const
+{
+  return {
+    .min = {.x = min_x[index], .y = min_y[index], .z = min_z[index]},
+    .max = {.x = max_x[index], .y = max_y[index], .z = max_z[index]}};
+}
+
+
+
+inline void transform(const Bbox3_soa& boxes, std::span<const dmatrix> mats, Bbox3_soa& result)
+{
+  using simd::dpack;
+  const dpack half = simd::broadcast(0.5);
+  result.resize(boxes.size());
+  for (size_t i = 0; i < boxes.size(); ++i)
+  {
+    if (boxes.max_x[i] < boxes.min_x[i])
+    {
+      result.set(i, {});
+      continue;
+    }
+
+    const dpack min_x = simd::broadcast(boxes.min_x[i]);
+    const dpack min_y = simd::broadcast(boxes.min_y[i]);
+    const dpack min_z = simd::broadcast(boxes.min_z[i]);
+    const dpack max_x = simd::broadcast(boxes.max_x[i]);
+    const dpack max_y = simd::broadcast(boxes.max_y[i]);
+    const dpack max_z = simd::broadcast(boxes.max_z[i]);
+    const dpack cx = (min_x + max_x) * half;
+    const dpack cy = (min_y + max_y) * half;
+    const dpack cz = (min_z + max_z) * half;
+    const dpack ex = (max_x - min_x) * half;
+    const dpack ey = (max_y - min_y) * half;
+    const dpack ez = (max_z - min_z) * half;
+
+    // matrix columns hold the transformed coordinates as rows, the 4th row result is not used
+    const double* m = mats[i].data;
+    double wcs_min[4];
+    double wcs_max[4];
+    for (int row = 0; row < 4; row += dpack::size)
+    {
+      const dpack col0 = simd::load(m + row);
+      const dpack col1 = simd::load(m + 4 + row);
+      const dpack col2 = simd::load(m + 8 + row);
+      const dpack center = simd::mul_add(
+        col0, cx, simd::mul_add(col1, cy, simd::mul_add(col2, cz, simd::load(m + 12 + row))));
+      const dpack ext = simd::mul_add(
+        simd::abs(col0), ex, simd::mul_add(simd::abs(col1), ey, simd::abs(col2) * ez));
+      simd::store(wcs_min + row, center - ext);
+      simd::store(wcs_max + row, center + ext);
+    }
+    result.set(
+      i,
+      {.min = {.x = wcs_min[0], .y = wcs_min[1], .z = wcs_min[2]},
+       .max = {.x = wcs_max[0], .y = wcs_max[1], .z = wcs_max[2]}});
+  }
+}
+
+} // namespace ares
+
+#endif //__ARES_BBOX3_SOA_H__
@@ -0,0 +1,509 @@
+#ifndef __ARES_BVH_H__
+#define __ARES_BVH_H__
+
+#include "bbox3.h"
+#include "cull.h"
+#include "plane.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace ares
+{
+
+/**
+ * @brief Bounding volume hierarchy over static bounding boxes (primitives), built top down with a
+ * binned surface area heuristic, subtrees are built in parallel. Use it for geometry that does not
+ * move, rebuild it when the primitives change
+ */
+class Bvh
+{
+public:
+
+  // tree node, 32 bytes so that 2 nodes fit in a cache line, children of a node are adjacent
+  struct Node
+  {
+    // bounding box min corner, rounded down to float
+    float min[3];
+    // inner node: first child index, the second child follows it, leaf: first primitive index in
+    // the leaf order
+    int32_t first{0};
+    // bounding box max corner, rounded up to float
+    float max[3];
+    // leaf primitives count, 0 for inner nodes
+    int32_t count{0};
+  };
+
+  // ray hit
+  struct Hit
+  {
+    // primitive index, -1 if nothing was hit
+    int32_t prim{-1};
+    // hit distance along the ray, in ray direction lengths
+    double dist{0};
+  };
+
+  /**
+   * @brief Build the hierarchy, replaces the previous one
+   * @param boxes Primitives bounding boxes, primitives are identified by their index in boxes,
+   * primitives with empty boxes are left out
+   */
+  void build(std::span<const Bbox3> boxes);
+
+  /**
+   * @brief Check if the hierarchy has no primitives
+   * @return Result of check
+   */
+  bool empty() const;
+
+  /**
+   * @brief Get all nodes, the root is the first node
+   * @return Nodes
+   */
+  std::span<const Node> nodes() const;
+
+  /**
+   * @brief Get all primitive indices in leaf order, leaves reference ranges of this array
+   * @return Primitive indices
+   */
+  std::span<const int32_t> prims() const;
+
+  /**
+   * @brief Visit the primitives inside or crossing a convex volume, nodes pass to their children
+   * the planes they are fully in front of so that these are not tested again, primitives of nodes
+   * fully inside are visited without further tests
+   * @tparam F Visitor type
+   * @param planes Planes with normals pointing inside the volume, e.g. frustum planes from
+   * Frustum::compute_planes, not required to be normalized
+   * @param visit Called as visit(int32_t prim, Visibility vis) for each primitive not outside
+   */
+  template <typename F>
+  void cull(const std::array<Plane, 6>& planes, F&& visit) const;
+
+  /**
+   * @brief Find the closest primitive hit by a ray, nodes are visited closest first and skipped
+   * when they are farther than the closest hit
+   * @tparam F Hit test type
+   * @param origin Ray origin
+   * @param dir Ray direction, not required to be normalized
+   * @param max_dist Max hit distance along the ray, in ray direction lengths
+   * @param hit Called as hit(int32_t prim) for primitives whose bounding box is hit, returns the
+   * hit distance along the ray, negative if the ray misses the primitive
+   * @return Closest hit
+   */
+  template <typename F>
+  Hit raycast(const dvec3& origin, const dvec3& dir, double max_dist, F&& hit) const;
+
+private:
+
+  // primitive being built, moved along with its bounding box so that nodes read contiguous memory
+  struct Build_prim
+  {
+    // bounding box
+    Bbox3 box;
+    // bounding box center
+    dvec3 center;
+    // primitive index
+    int32_t index{0};
+  };
+
+  // build state shared by the build tasks
+  struct Build
+  {
+    // primitives, partitioned in leaf order
+    std::vector<Build_prim> prims;
+    // number of used nodes
+    std::atomic<int32_t> node_count{0};
+    // nodes up to this depth build one of their subtrees in a new task
+    int32_t task_depth{0};
+  };
+
+  /**
+   * @brief Build a node and its subtree, splits in 2 subtrees built in parallel when large enough
+   * @param build Build state
+   * @param index Node index
+   * @param begin First primitive index in the leaf order
+   * @param end Primitive index after the last one in the leaf order
+   * @param depth Node depth, root is 0
+   */
+  void build_node(Build& build, int32_t index, int32_t begin, int32_t end, int32_t depth);
+
+  /**
+   * @brief Compute the distance along a ray at which it enters a node bounding box
+   * @param node Node to use
+   * @param origin Ray origin
+   * @param inv_dir Ray direction inverse components
+   * @param max_dist Max distance along the ray
+   * @return Entry distance, infinity if the box is missed or farther than max_dist
+   */
+  static double enter_dist(
+    const Node& node, const dvec3& origin, const dvec3& inv_dir, double max_dist);
+
+  /**
+   * @brief Compute the surface area of a bounding box
+   * @param box Bounding box to use
+   * @return Surface area, 0 if empty
+   */
+  static double area(const Bbox3& box);
+
+  // binned surface area heuristic bins per axis
+  static constexpr int32_t bins = 16;
+  // max primitives count of a leaf, unless the max depth is reached
+  static constexpr int32_t max_leaf = 4;
+  // subtrees with fewer primitives are built by the task that split their parent
+  static constexpr int32_t min_task = 4096;
+  // max tree depth, bounds the traversal stacks
+  static constexpr int32_t max_depth = 60;
+
+  // nodes, root first
+  std::vector<Node> _nodes;
+  // primitive indices in leaf order
+  std::vector<int32_t> _prims;
+  // primitives bounding boxes in leaf order
+  std::vector<Bbox3> _boxes;
+};
+
+
+
+inline void Bvh::build(std::span<const Bbox3> boxes)
+{
+  _nodes.clear();
+  _prims.clear();
+  _boxes.clear();
+
+  Build build;
+  build.prims.reserve(boxes.size());
+  for (int32_t i = 0; i < static_cast<int32_t>(boxes.size()); ++i)
+  {
+    if (boxes[i].min.x <= boxes[i].max.x)
+    {
+      build.prims.push_back({.box = boxes[i], .center = boxes[i].center(), .index = i});
+    }
+  }
+  const auto count = static_cast<int32_t>(build.prims.size());
+  if (0 == count)
+  {
+    return;
+  }
+
+  // a binary tree with leaves of at least 1 primitive has at most 2n - 1 nodes
+  _nodes.resize(2 * static_cast<size_t>(count) - 1);
+  build.node_count = 1;
+  const auto threads = std::thread::hardware_concurrency();
+  build.task_depth = static_cast<int32_t>(std::bit_width(threads)) + 1;
+  build_node(build, 0, 0, count, 0);
+  _nodes.resize(build.node_count);
+
+  _prims.reserve(count);
+  _boxes.reserve(count);
+  for (const auto& prim : build.prims)
+  {
+    _prims.push_back(prim.index);
+    _boxes.push_back(prim.box);
+  }
+}
+
+
+
+inline bool Bvh::empty() const
+{
+  return _nodes.empty();
+}
+
+
+
+inline std::span<const Bvh::Node> Bvh::nodes() const
+{
+  return _nodes;
+}
+
+
+
+inline std::span<const int32_t> Bvh::prims() const
+{
+  return _prims;
+}
+
+
+
+template <typename F>
+void Bvh::cull(const std::array<Plane, 6>& planes, F&& visit) const
+{
+  if (_nodes.empty())
+  {
+    return;
+  }
+
+  // nodes to visit with the mask of the planes that their parent crosses
+  struct Entry
+  {
+    int32_t node;
+    int32_t mask;
+  };
+  Entry stack[max_depth + 2];
+  int32_t size = 0;
+  stack[size++] = {.node = 0, .mask = 0x3f};
+  while (size > 0)
+  {
+    const auto entry = stack[--size];
+    const auto& node = _nodes[entry.node];
+    const auto mask = ares::classify(
+      {.min = {.x = node.min[0], .y = node.min[1], .z = node.min[2]},
+       .max = {.x = node.max[0], .y = node.max[1], .z = node.max[2]}},
+      planes,
+      entry.mask);
+    if (mask < 0)
+    {
+      continue;
+    }
+
+    if (0 == node.count)
+    {
+      stack[size++] = {.node = node.first, .mask = mask};
+      stack[size++] = {.node = node.first + 1, .mask = mask};
+      continue;
+    }
+
+    for (int32_t i = node.first; i < node.first + node.count; ++i)
+    {
+      const auto prim_mask = 0 == mask ? 0 : ares::classify(_boxes[i], planes, mask);
+      if (prim_mask >= 0)
+      {
+        visit(_prims[i], 0 == prim_mask ? Visibility::Inside : Visibility::Intersects);
+      }
+    }
+  }
+}
+
+
+
+template <typename F>
+Bvh::Hit Bvh::raycast(const dvec3& origin, const dvec3& dir, double max_dist, F&& hit) const
+{
+  Hit closest{.dist = max_dist};
+  if (_nodes.empty())
+  {
+    return closest;
+  }
+
+  // divisions by 0 give infinities that the slab test handles
+  const dvec3 inv_dir{.x = 1 / dir.x, .y = 1 / dir.y, .z = 1 / dir.z};
+  if (std::isinf(enter_dist(_nodes[0], origin, inv_dir, max_dist)))
+  {
+    return closest;
+  }
+
+  // nodes to visit with their entry distance
+  struct Entry
+  {
+    int32_t node;
+    double dist;
+  };
+  Entry stack[max_depth + 2];
+  int32_t size = 0;
+  stack[size++] = {.node = 0, .dist = 0};
+  while (size > 0)
+  {
+    const auto entry = stack[--size];
+    if (entry.dist > closest.dist)
+    {
+      continue;
+    }
+
+    const auto& node = _nodes[entry.node];
+    if (0 != node.count)
+    {
+      for (int32_t i = node.first; i < node.first + node.count; ++i)
+      {
+        const auto dist = hit(_prims[i]);
+        if (dist >= 0 && dist < closest.dist)
+        {
+          closest = {.prim = _prims[i], .dist = dist};
+        }
+      }
+      continue;
+    }
+
+    // the closest child is pushed last so that it is visited first
+    Entry near{
+      .node = node.first, .dist = enter_dist(_nodes[node.first], origin, inv_dir, closest.dist)};
+    Entry far{
+      .node = node.first + 1,
+      .dist = enter_dist(_nodes[node.first + 1], origin, inv_dir, closest.dist)};
+    if (far.dist < near.dist)
+    {
+      std::swap(near, far);
+    }
+    if (!std::isinf(far.dist))
+    {
+      stack[size++] = far;
+    }
+    if (!std::isinf(near.dist))
+    {
+      stack[size++] = near;
+    }
+  }
+  return closest;
+}
+
+
+
+inline void Bvh::build_node(Build& build, int32_t index, int32_t begin, int32_t end, int32_t depth)
+{
+  Bbox3 bounds;
+  Bbox3 center_bounds;
+  const auto prims = std::span{build.prims}.subspan(begin, end - begin);
+  for (const auto& prim : prims)
+  {
+    bounds.extend(prim.box);
+    center_bounds.extend(prim.center);
+  }
+
+  // float bounds are rounded outwards so that they still contain the primitives
+  auto& node = _nodes[index];
+  const double dmin[3] = {bounds.min.x, bounds.min.y, bounds.min.z};
+  const double dmax[3] = {bounds.max.x, bounds.max.y, bounds.max.z};
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    node.min[axis] = static_cast<float>(dmin[axis]);
+    node.max[axis] = static_cast<float>(dmax[axis]);
+    if (node.min[axis] > dmin[axis])
+    {
+      node.min[axis] = std::nextafter(node.min[axis], -std::numeric_limits<float>::infinity());
+    }
+    if (node.max[axis] < dmax[axis])
+    {
+      node.max[axis] = std::nextafter(node.max[axis], std::numeric_limits<float>::infinity());
+    }
+  }
+
+  const int32_t count = end - begin;
+  node.first = begin;
+  node.count = count;
+  if (count <= max_leaf || depth >= max_depth)
+  {
+    return;
+  }
+
+  // bin the primitives by center along the axis where the centers spread the most, all centers
+  // equal are split in the middle of their range
+  const dvec3 spread = center_bounds.max - center_bounds.min;
+  const int axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : spread.y >= spread.z ? 1 : 2;
+  const auto coord = [axis](const dvec3& v) { return 0 == axis ? v.x : 1 == axis ? v.y : v.z; };
+  const double extent = coord(spread);
+  int32_t mid = begin + count / 2;
+  if (extent > 0)
+  {
+    struct Bin
+    {
+      Bbox3 bounds;
+      int32_t count{0};
+    };
+    Bin axis_bins[bins];
+    const double cmin = coord(center_bounds.min);
+    const double scale = bins / extent;
+    const auto bin_of = [&](const Build_prim& prim)
+    { return std::min(static_cast<int32_t>((coord(prim.center) - cmin) * scale), bins - 1); };
+    for (const auto& prim : prims)
+    {
+      auto& bin = axis_bins[bin_of(prim)];
+      bin.bounds.extend(prim.box);
+      ++bin.count;
+    }
+
+    // split cost is the children areas weighted by their primitives count, the node area and
+    // traversal cost are the same for all splits of a node, the first and last bins are never
+    // empty so there is always a split
+    double right_cost[bins] = {0};
+    Bbox3 right;
+    int32_t right_count = 0;
+    for (int32_t b = bins - 1; b > 0; --b)
+    {
+      right.extend(axis_bins[b].bounds);
+      right_count += axis_bins[b].count;
+      right_cost[b] = area(right) * right_count;
+    }
+
+    double best_cost = std::numeric_limits<double>::max();
+    int32_t best_split = 1;
+    Bbox3 left;
+    int32_t left_count = 0;
+    for (int32_t b = 1; b < bins; ++b)
+    {
+      left.extend(axis_bins[b - 1].bounds);
+      left_count += axis_bins[b - 1].count;
+      const double cost = area(left) * left_count + right_cost[b];
+      if (cost < best_cost)
+      {
+        best_cost = cost;
+        best_split = b;
+      }
+    }
+
+    const auto it = std::partition(
+      prims.begin(),
+      prims.end(),
+      [&](const Build_prim& prim) { return bin_of(prim) < best_split; });
+    mid = begin + static_cast<int32_t>(it - prims.begin());
+  }
+
+  const auto first = build.node_count.fetch_add(2);
+  node.first = first;
+  node.count = 0;
+  if (count >= min_task && depth < build.task_depth)
+  {
+    auto left = std::async(
+      std::launch::async, [&, first] { build_node(build, first, begin, mid, depth + 1); });
+    build_node(build, first + 1, mid, end, depth + 1);
+    left.get();
+  }
+  else
+  {
+    build_node(build, first, begin, mid, depth + 1);
+    build_node(build, first + 1, mid, end, depth + 1);
+  }
+}
+
+
+
+inline double Bvh::enter_dist(
+  const Node& node, const dvec3& origin, const dvec3& inv_dir, double max_dist)
+{
+  const double tx0 = (node.min[0] - origin.x) * inv_dir.x;
+  const double tx1 = (node.max[0] - origin.x) * inv_dir.x;
+  const double ty0 = (node.min[1] - origin.y) * inv_dir.y;
+  const double ty1 = (node.max[1] - origin.y) * inv_dir.y;
+  const double tz0 = (node.min[2] - origin.z) * inv_dir.z;
+  const double tz1 = (node.max[2] - origin.z) * inv_dir.z;
+  const double enter = std::max({std::min(tx0, tx1), std::min(ty0, ty1), std::min(tz0, tz1), 0.0});
+  const double exit =
+    std::min({std::max(tx0, tx1), std::max(ty0, ty1), std::max(tz0, tz1), max_dist});
+  return enter <= exit ? enter : std::numeric_limits<double>::infinity();
+}
+
+
+
+inline double Bvh::area(const Bbox3& box)
+{
+  if (box.max.x < box.min.x)
+  {
+    return 0;
+  }
+
+  const dvec3 size = box.max - box.min;
+  return 2 * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+} // namespace ares
+
+#endif //__ARES_BVH_H__
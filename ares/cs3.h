@@ -2,6 +2,7 @@
 #define __ARES_CS3_H__
 
 #include "concepts.h"
+#include "quat.h"
 #include "vec3.h"
 
 namespace ares
@@ -11,6 +12,7 @@ template <std::floating_point T>
 struct Cs3;
 
 using dcs3 = Cs3<double>;
+using fcs3 = Cs3<float>;
 
 /**
  * @brief Right handed cartesian coordinate system
@@ -28,6 +30,34 @@ struct Cs3
    */
   static constexpr Cs3 make(const Vec3<T>& origin, const Vec3<T>& x_axis, const Vec3<T>& y_axis);
 
+  /**
+   * @brief Make coordinate system from an origin and a rotation of the world axes
+   * @param origin Origin
+   * @param rotation Rotation, must be normalized
+   * @return Coordinate system
+   */
+  static constexpr Cs3 make(const Vec3<T>& origin, const Quat<T>& rotation);
+
+  /**
+   * @brief Get the rotation that takes the world axes to the cs axes
+   * @return Quaternion
+   */
+  constexpr Quat<T> rotation() const;
+
+  /**
+   * @brief Rotate the axes by a world rotation, the axes are rebuilt from the composed and
+   * renormalized quaternion so they stay orthonormal however many rotations are applied
+   * @param rotation Rotation, must be normalized
+   */
+  constexpr void rotate(const Quat<T>& rotation);
+
+  /**
+   * @brief Rotate the axes by a rotation expressed in this cs, e.g. around its own y axis, the
+   * axes stay orthonormal as for rotate
+   * @param rotation Rotation, must be normalized
+   */
+  constexpr void rotate_local(const Quat<T>& rotation);
+
   /**
    * @brief Set the x axis, computes the other axis
    * @param x_axis X axis to set, must be normalized
@@ -88,6 +118,44 @@ constexpr Cs3<T> Cs3<T>::make(const Vec3<T>& origin, const Vec3<T>& x_axis, cons
 
 
 
+template <std::floating_point T>
+constexpr Cs3<T> Cs3<T>::make(const Vec3<T>& origin, const Quat<T>& rotation)
+{
+  Cs3 cs{.origin = origin};
+  rotation.to_axes(cs.x_axis, cs.y_axis, cs.z_axis);
+  return cs;
+}
+
+
+
+template <std::floating_point T>
+constexpr Quat<T> Cs3<T>::rotation() const
+{
+  return Quat<T>::make_from_axes(x_axis, y_axis, z_axis);
+}
+
+
+
+template <std::floating_point T>
+constexpr void Cs3<T>::rotate(const Quat<T>& rotation)
+{
+  auto q = rotation * this->rotation();
+  q.normalize();
+  q.to_axes(x_axis, y_axis, z_axis);
+}
+
+
+
+template <std::floating_point T>
+constexpr void Cs3<T>::rotate_local(const Quat<T>& rotation)
+{
+  auto q = this->rotation() * rotation;
+  q.normalize();
+  q.to_axes(x_axis, y_axis, z_axis);
+}
+
+
+
 template <std::floating_point T>
 constexpr void Cs3<T>::set_x_axis(const Vec3<T>& x_axis)
 {
@@ -148,8 +216,7 @@ constexpr void Cs3<T>::normalize()
 template <std::floating_point T>
 constexpr void Cs3<T>::rotate_by_x(double rad)
 {
-  y_axis.rotate(x_axis, rad);
-  compute_z();
+  rotate_local(Quat<T>::make_from({.x = 1}, static_cast<T>(rad)));
 }
 
 
@@ -157,8 +224,7 @@ constexpr void Cs3<T>::rotate_by_x(double rad)
 template <std::floating_point T>
 constexpr void Cs3<T>::rotate_by_y(double rad)
 {
-  z_axis.rotate(y_axis, rad);
-  compute_x();
+  rotate_local(Quat<T>::make_from({.y = 1}, static_cast<T>(rad)));
 }
 
 
@@ -166,8 +232,7 @@ constexpr void Cs3<T>::rotate_by_y(double rad)
 template <std::floating_point T>
 constexpr void Cs3<T>::rotate_by_z(double rad)
 {
-  x_axis.rotate(z_axis, rad);
-  compute_y();
+  rotate_local(Quat<T>::make_from({.z = 1}, static_cast<T>(rad)));
 }
 
 } // namespace ares
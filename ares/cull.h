@@ -0,0 +1,352 @@
+#ifndef __ARES_CULL_H__
+#define __ARES_CULL_H__
+
+#include "bbox3.h"
+#include "bbox3_soa.h"
+#include "frustum.h"
+#include "plane.h"
+#include "simd.h"
+
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+
+namespace ares
+{
+
+// bounding box visibility against a set of planes
+enum class Visibility : uint8_t
+{
+  Outside = 0, // fully on the back side of at least one plane
+  Intersects,  // crosses at least one plane
+  Inside       // fully on the front side of all planes
+};
+
+/**
+ * @brief Classify bounding boxes against convex volume planes, e.g. frustum planes from
+ * Frustum::compute_planes. Each box is tested with its n and p vertices, the corners that are the
+ * farthest behind and in front of each plane, computed as the center distance minus and plus the
+ * box half extents projected on the plane normal. Planes are tested together in SIMD packs, all 6
+ * in a single pack for floats with AVX. Floats classify boxes as doubles do, except boxes whose n
+ * or p vertex is closer to a plane than 1e-6 times the magnitude of the box coordinates and of the
+ * plane distance to the origin
+ * @tparam T Floating point type to use
+ * @param planes Planes with normals pointing inside the volume, not required to be normalized
+ * @param boxes Bounding boxes to classify, empty boxes are outside
+ * @param result Visibility of each box, same size as boxes
+ */
+template <std::floating_point T>
+void cull(
+  const std::array<Plane_t<T>, 6>& planes,
+  std::type_identity_t<std::span<const Bbox3_t<T>>> boxes,
+  std::span<Visibility> result);
+
+/**
+ * @brief Classify bounding boxes stored as structure of arrays against convex volume planes, with
+ * the same test as above but several boxes are tested together in SIMD packs
+ * @param planes Planes with normals pointing inside the volume, not required to be normalized
+ * @param boxes Bounding boxes to classify, empty boxes are outside
+ * @param result Visibility of each box, same size as boxes
+ */
+void cull(
+  const std::array<Plane, 6>& planes, const Bbox3_soa& boxes, std::span<Visibility> result);
+
+/**
+ * @brief Classify a bounding box against the planes that are set in a plane mask, with the same
+ * test as cull and the same float precision, for hierarchies where children skip the planes their
+ * parent is fully in front of
+ * @tparam T Floating point type to use
+ * @param box Bounding box to classify, must not be empty
+ * @param planes Planes with normals pointing inside the volume, not required to be normalized
+ * @param mask Bit i set if plane i must be tested
+ * @return Mask of the tested planes that the box crosses, -1 if the box is outside
+ */
+template <std::floating_point T>
+int32_t classify(const Bbox3_t<T>& box, const std::array<Plane_t<T>, 6>& planes, int32_t mask);
+
+/**
+ * @brief Classify bounding boxes against a view frustum one by one, exploiting the temporal
+ * coherency of the view. The plane that rejected a box last time is tested first, boxes that fail
+ * it again need a single plane test. Then the frustum is split in octants by its mid depth plane
+ * and the planes through its axis, a box fully inside an octant cannot be rejected or crossed by
+ * the planes of the opposite octants so these are skipped
+ * @param frustum View frustum, its planes are computed with Frustum::compute_planes
+ * @param boxes Bounding boxes to classify, empty boxes are outside
+ * @param rejecting Per box state kept between calls, the index of the frustum plane that last
+ * rejected the box, same size as boxes, initialize with zeros
+ * @param result Visibility of each box, same size as boxes
+ * @return Number of frustum plane tests
+ */
+int32_t cull(
+  const Frustum& frustum,
+  const Bbox3_soa& boxes,
+  std::span<uint8_t> rejecting,
+  std::span<Visibility> result);
+
+
+
+template <std::floating_point T>
+void cull(
+  const std::array<Plane_t<T>, 6>& planes,
+  std::type_identity_t<std::span<const Bbox3_t<T>>> boxes,
+  std::span<Visibility> result)
+{
+  using P = simd::pack<T>;
+  constexpr int packs = (6 + P::size - 1) / P::size;
+  constexpr int count = packs * P::size;
+
+  // planes as structure of arrays, padding planes never reject: zero normal and positive d
+  T nx[count], ny[count], nz[count], ax[count], ay[count], az[count], d[count];
+  for (int i = 0; i < count; ++i)
+  {
+    const Vec3<T> n = i < 6 ? planes[i].normal : Vec3<T>{};
+    nx[i] = n.x;
+    ny[i] = n.y;
+    nz[i] = n.z;
+    ax[i] = std::abs(n.x);
+    ay[i] = std::abs(n.y);
+    az[i] = std::abs(n.z);
+    d[i] = i < 6 ? planes[i].d : 1;
+  }
+
+  const P zero = simd::broadcast(T(0));
+  for (size_t b = 0; b < boxes.size(); ++b)
+  {
+    const auto& box = boxes[b];
+    const P cx = simd::broadcast((box.min.x + box.max.x) / 2);
+    const P cy = simd::broadcast((box.min.y + box.max.y) / 2);
+    const P cz = simd::broadcast((box.min.z + box.max.z) / 2);
+    const P ex = simd::broadcast((box.max.x - box.min.x) / 2);
+    const P ey = simd::broadcast((box.max.y - box.min.y) / 2);
+    const P ez = simd::broadcast((box.max.z - box.min.z) / 2);
+
+    // empty boxes have their min corner past their max corner
+    int outside = box.max.x < box.min.x ? simd::full_mask<P> : 0;
+    int crossing = 0;
+    for (int p = 0; p < count; p += P::size)
+    {
+      // signed center distance and the box radius along the plane normal
+      P dist = simd::mul_add(simd::load(nx + p), cx, simd::load(d + p));
+      dist = simd::mul_add(simd::load(ny + p), cy, dist);
+      dist = simd::mul_add(simd::load(nz + p), cz, dist);
+      P radius = simd::load(ax + p) * ex;
+      radius = simd::mul_add(simd::load(ay + p), ey, radius);
+      radius = simd::mul_add(simd::load(az + p), ez, radius);
+
+      // the p vertex is behind the plane, or the n vertex is behind it
+      outside |= simd::less(dist + radius, zero);
+      crossing |= simd::less(dist - radius, zero);
+    }
+
+    result[b] = 0 != outside  ? Visibility::Outside
+              : 0 != crossing ? Visibility::Intersects
+                              : Visibility::Inside;
+  }
+}
+
+
+
+inline void cull(
+  const std::array<Plane, 6>& planes, const Bbox3_soa& boxes, std::span<Visibility> result)
+{
+  using simd::dpack;
+  const dpack zero = simd::broadcast(0.0);
+  const dpack half = simd::broadcast(0.5);
+  const size_t count = boxes.size();
+  const size_t packed = count - count % dpack::size;
+  for (size_t b = 0; b < packed; b += dpack::size)
+  {
+    const dpack min_x = simd::load(boxes.min_x.data() + b);
+    const dpack min_y = simd::load(boxes.min_y.data() + b);
+    const dpack min_z = simd::load(boxes.min_z.data() + b);
+    const dpack max_x = simd::load(boxes.max_x.data() + b);
+    const dpack max_y = simd::load(boxes.max_y.data() + b);
+    const dpack max_z = simd::load(boxes.max_z.data() + b);
+    const dpack cx = (min_x + max_x) * half;
+    const dpack cy = (min_y + max_y) * half;
+    const dpack cz = (min_z + max_z) * half;
+    const dpack ex = (max_x - min_x) * half;
+    const dpack ey = (max_y - min_y) * half;
+    const dpack ez = (max_z - min_z) * half;
+
+    // empty boxes have their min corner past their max corner
+    int outside = simd::less(max_x, min_x);
+    int crossing = 0;
+    for (const auto& plane : planes)
+    {
+      // signed center distances and the boxes radii along the plane normal
+      dpack dist = simd::mul_add(simd::broadcast(plane.normal.x), cx, simd::broadcast(plane.d));
+      dist = simd::mul_add(simd::broadcast(plane.normal.y), cy, dist);
+      dist = simd::mul_add(simd::broadcast(plane.normal.z), cz, dist);
+      dpack radius = simd::broadcast(std::abs(plane.normal.x)) * ex;
+      radius = simd::mul_add(simd::broadcast(std::abs(plane.normal.y)), ey, radius);
+      radius = simd::mul_add(simd::broadcast(std::abs(plane.normal.z)), ez, radius);
+
+      outside |= simd::less(dist + radius, zero);
+      crossing |= simd::less(dist - radius, zero);
+    }
+
+    for (int i = 0; i < dpack::size; ++i)
+    {
+      const int bit = 1 << i;
+      result[b + i] = 0 != (outside & bit)  ? Visibility::Outside
+                    : 0 != (crossing & bit) ? Visibility::Intersects
+                                            : Visibility::Inside;
+    }
+  }
+
+  // remaining boxes that do not fill a pack
+  for (size_t b = packed; b < count; ++b)
+  {
+    const Bbox3 box = boxes.get(b);
+    cull(planes, std::span{&box, 1}, result.subspan(b, 1));
+  }
+}
+
+
+
+template <std::floating_point T>
+int32_t classify(const Bbox3_t<T>& box, const std::array<Plane_t<T>, 6>& planes, int32_t mask)
+{
+  const Vec3<T> center = box.center();
+  const Vec3<T> ext = (box.max - box.min) / 2;
+  int32_t crossing = 0;
+  for (int32_t i = 0; i < 6; ++i)
+  {
+    if (0 == (mask & (1 << i)))
+    {
+      continue;
+    }
+
+    const auto& normal = planes[i].normal;
+    const T dist = normal.dot(center) + planes[i].d;
+    const T radius =
+      std::abs(normal.x) * ext.x + std::abs(normal.y) * ext.y + std::abs(normal.z) * ext.z;
+    if (dist + radius < 0)
+    {
+      return -1;
+    }
+    if (dist - radius < 0)
+    {
+      crossing |= 1 << i;
+    }
+  }
+  return crossing;
+}
+
+
+
+inline int32_t cull(
+  const Frustum& frustum,
+  const Bbox3_soa& boxes,
+  std::span<uint8_t> rejecting,
+  std::span<Visibility> result)
+{
+  const auto planes = frustum.compute_planes();
+  double nx[6], ny[6], nz[6], ax[6], ay[6], az[6], d[6];
+  for (int32_t i = 0; i < 6; ++i)
+  {
+    nx[i] = planes[i].normal.x;
+    ny[i] = planes[i].normal.y;
+    nz[i] = planes[i].normal.z;
+    ax[i] = std::abs(nx[i]);
+    ay[i] = std::abs(ny[i]);
+    az[i] = std::abs(nz[i]);
+    d[i] = planes[i].d;
+  }
+
+  // octant split planes, the depth split through the frustum mid point and the height and width
+  // splits through its axis. A box past the depth split is in front of the near plane, before it
+  // in front of the far plane. A box above the height split is in front of the bottom plane where
+  // it is in front of the near plane, and the near plane rejects or crosses it anyway elsewhere,
+  // the same goes for the other side and the width split
+  const auto& cs = frustum.cs;
+  const dvec3 mid = cs.origin + cs.x_axis * ((frustum.near + frustum.far) * 0.5);
+  const dvec3 axes[3] = {cs.x_axis, cs.y_axis, cs.z_axis};
+  const dvec3 origins[3] = {mid, cs.origin, cs.origin};
+  // planes skipped for a box fully on the positive and negative side of each split plane, planes
+  // are near, far, bottom, top, left, right
+  constexpr int32_t positive_skip[3] = {1 << 0, 1 << 2, 1 << 4};
+  constexpr int32_t negative_skip[3] = {1 << 1, 1 << 3, 1 << 5};
+
+  int32_t tests = 0;
+  for (size_t b = 0; b < boxes.size(); ++b)
+  {
+    // empty boxes have their min corner past their max corner
+    if (boxes.max_x[b] < boxes.min_x[b])
+    {
+      result[b] = Visibility::Outside;
+      continue;
+    }
+
+    const dvec3 center{
+      .x = (boxes.min_x[b] + boxes.max_x[b]) * 0.5,
+      .y = (boxes.min_y[b] + boxes.max_y[b]) * 0.5,
+      .z = (boxes.min_z[b] + boxes.max_z[b]) * 0.5};
+    const dvec3 ext{
+      .x = (boxes.max_x[b] - boxes.min_x[b]) * 0.5,
+      .y = (boxes.max_y[b] - boxes.min_y[b]) * 0.5,
+      .z = (boxes.max_z[b] - boxes.min_z[b]) * 0.5};
+
+    // the last rejecting plane first
+    const int32_t last = rejecting[b];
+    const double last_dist =
+      nx[last] * center.x + ny[last] * center.y + nz[last] * center.z + d[last];
+    const double last_radius = ax[last] * ext.x + ay[last] * ext.y + az[last] * ext.z;
+    ++tests;
+    if (last_dist + last_radius < 0)
+    {
+      result[b] = Visibility::Outside;
+      continue;
+    }
+    bool crossing = last_dist - last_radius < 0;
+
+    int32_t mask = 0x3f & ~(1 << last);
+    for (int32_t i = 0; i < 3; ++i)
+    {
+      const auto& axis = axes[i];
+      const double dist = axis.dot(center - origins[i]);
+      const double radius =
+        std::abs(axis.x) * ext.x + std::abs(axis.y) * ext.y + std::abs(axis.z) * ext.z;
+      if (dist - radius >= 0)
+      {
+        mask &= ~positive_skip[i];
+      }
+      else if (dist + radius <= 0)
+      {
+        mask &= ~negative_skip[i];
+      }
+    }
+
+    bool outside = false;
+    for (int32_t i = 0; i < 6 && !outside; ++i)
+    {
+      if (0 == (mask & (1 << i)))
+      {
+        continue;
+      }
+
+      const double dist = nx[i] * center.x + ny[i] * center.y + nz[i] * center.z + d[i];
+      const double radius = ax[i] * ext.x + ay[i] * ext.y + az[i] * ext.z;
+      ++tests;
+      if (dist + radius < 0)
+      {
+        rejecting[b] = static_cast<uint8_t>(i);
+        outside = true;
+      }
+      crossing = crossing || dist - radius < 0;
+    }
+
+    result[b] = outside ? Visibility::Outside
+              : crossing ? Visibility::Intersects
+                         : Visibility::Inside;
+  }
+  return tests;
+}
+
+} // namespace ares
+
+#endif //__ARES_CULL_H__
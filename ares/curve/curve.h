@@ -1,7 +1,7 @@
 #ifndef __ARES_CURVE_H__
 #define __ARES_CURVE_H__
 
-#include <cmath>
+#include "../fast.h"
 
 namespace ares
 {
@@ -86,56 +86,58 @@ inline double Curve::linear(double progress)
 
 inline double Curve::in_quad(double progress)
 {
-  return pow(progress, 2);
+  return fast::pow<2>(progress);
 }
 
 
 
 inline double Curve::out_quad(double progress)
 {
-  return 1 - pow(1 - progress, 2);
+  return 1 - fast::pow<2>(1 - progress);
 }
 
 
 
 inline double Curve::in_out_quad(double progress)
 {
-  return progress <= 0.5 ? 2 * pow(progress, 2) : 1 - 2 * pow(1 - progress, 2);
+  return progress <= 0.5 ? 2 * fast::pow<2>(progress) : 1 - 2 * fast::pow<2>(1 - progress);
 }
 
 
 
 inline double Curve::out_in_quad(double progress)
 {
-  return progress <= 0.5 ? 0.5 - 2 * pow(0.5 - progress, 2) : 0.5 + 2 * pow(progress - 0.5, 2);
+  return progress <= 0.5 ? 0.5 - 2 * fast::pow<2>(0.5 - progress)
+                         : 0.5 + 2 * fast::pow<2>(progress - 0.5);
 }
 
 
 
 inline double Curve::in_cubic(double progress)
 {
-  return pow(progress, 3);
+  return fast::pow<3>(progress);
 }
 
 
 
 inline double Curve::out_cubic(double progress)
 {
-  return 1 - pow(1 - progress, 3);
+  return 1 - fast::pow<3>(1 - progress);
 }
 
 
 
 inline double Curve::in_out_cubic(double progress)
 {
-  return progress <= 0.5 ? 4 * pow(progress, 3) : 1 - 4 * pow(1 - progress, 3);
+  return progress <= 0.5 ? 4 * fast::pow<3>(progress) : 1 - 4 * fast::pow<3>(1 - progress);
 }
 
 
 
 inline double Curve::out_in_cubic(double progress)
 {
-  return progress <= 0.5 ? 0.5 - 4 * pow(0.5 - progress, 3) : 0.5 + 4 * pow(progress - 0.5, 3);
+  return progress <= 0.5 ? 0.5 - 4 * fast::pow<3>(0.5 - progress)
+                         : 0.5 + 4 * fast::pow<3>(progress - 0.5);
 }
 
 } // namespace ares
@@ -1,22 +1,31 @@
 #ifndef __ARES_CURVE3D_H__
 #define __ARES_CURVE3D_H__
 
+#include "../concepts.h"
 #include "../vec3.h"
 
 namespace ares
 {
 
+template <std::floating_point T>
+class Curve3d_t;
+
+using Curve3d = Curve3d_t<double>;
+using Curve3df = Curve3d_t<float>;
+
 /**
  * @brief Geometric 3D curve
+ * @tparam T Floating point type to use
  */
-class Curve3d
+template <std::floating_point T>
+class Curve3d_t
 {
 public:
 
   struct Params
   {
-    dvec3 position;
-    dvec3 tangent;
+    Vec3<T> position;
+    Vec3<T> tangent;
   };
 
   /**
@@ -24,65 +33,66 @@ public:
    * @param start Curve start
    * @param end Curve end
    */
-  Curve3d(const dvec3& start, const dvec3& end);
+  Curve3d_t(const Vec3<T>& start, const Vec3<T>& end);
 
   /**
    * @brief Destroy the object
    */
-  virtual ~Curve3d() = default;
+  virtual ~Curve3d_t() = default;
 
   /**
    * @brief Get start point
    * @return Start point
    */
-  const dvec3& start() const;
+  const Vec3<T>& start() const;
 
   /**
    * @brief Get end point
    * @return End point
    */
-  const dvec3& end() const;
+  const Vec3<T>& end() const;
 
   /**
    * @brief Get the curve length
    * @return Length
    */
-  double length() const;
+  T length() const;
 
   /**
    * @brief Compute position at curve progress
    * @param progress Progress to use in [0, 1] interval
    * @return Position at progress
    */
-  virtual dvec3 position_at(double progress) const = 0;
+  virtual Vec3<T> position_at(T progress) const = 0;
 
   /**
    * @brief Compute tangent at curve progress
    * @param progress Progress to use in [0, 1] interval
    * @return Tangent at progress
    */
-  virtual dvec3 tangent_at(double progress) const = 0;
+  virtual Vec3<T> tangent_at(T progress) const = 0;
 
   /**
    * @brief Compute curve parameters at progress
    * @param progress Progress to use in [0, 1] interval
    * @return Curve parameters
    */
-  virtual Params params_at(double progress) const = 0;
+  virtual Params params_at(T progress) const = 0;
 
 protected:
 
   // Curve start point
-  dvec3 _start;
+  Vec3<T> _start;
   // Curve end point
-  dvec3 _end;
+  Vec3<T> _end;
   // Curve lentgh
-  double _length{0};
+  T _length{0};
 };
 
 
 
-inline Curve3d::Curve3d(const dvec3& start, const dvec3& end)
+template <std::floating_point T>
+Curve3d_t<T>::Curve3d_t(const Vec3<T>& start, const Vec3<T>& end)
   : _start(start)
   , _end(end)
   , _length((end - start).length())
@@ -91,21 +101,24 @@ inline Curve3d::Curve3d(const dvec3& start, const dvec3& end)
 
 
 
-inline const dvec3& Curve3d::start() const
+template <std::floating_point T>
+const Vec3<T>& Curve3d_t<T>::start() const
 {
   return _start;
 }
 
 
 
-inline const dvec3& Curve3d::end() const
+template <std::floating_point T>
+const Vec3<T>& Curve3d_t<T>::end() const
 {
   return _end;
 }
 
 
 
-inline double Curve3d::length() const
+template <std::floating_point T>
+T Curve3d_t<T>::length() const
 {
   return _length;
 }
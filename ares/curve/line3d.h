@@ -6,72 +6,86 @@
 namespace ares
 {
 
+template <std::floating_point T>
+class Line3d_t;
+
+using Line3d = Line3d_t<double>;
+using Line3df = Line3d_t<float>;
+
 /**
  * @brief Geometric 3D line
+ * @tparam T Floating point type to use
  */
-class Line3d : public Curve3d
+template <std::floating_point T>
+class Line3d_t : public Curve3d_t<T>
 {
 public:
 
+  using typename Curve3d_t<T>::Params;
+
   /**
    * @brief Construct a new object
    * @param start Line start
    * @param end Line end
    */
-  Line3d(const dvec3& start, const dvec3& end);
+  Line3d_t(const Vec3<T>& start, const Vec3<T>& end);
 
   /**
    * @brief Compute position at curve progress
    * @param progress Progress to use in [0, 1] interval
    * @return Position at progress
    */
-  dvec3 position_at(double progress) const override;
+  Vec3<T> position_at(T progress) const override;
 
   /**
    * @brief Compute tangent at curve progress
    * @param progress Progress to use in [0, 1] interval
    * @return Tangent at progress
    */
-  dvec3 tangent_at(double progress) const override;
+  Vec3<T> tangent_at(T progress) const override;
 
   /**
    * @brief Compute curve parameters at progress
    * @param progress Progress to use in [0, 1] interval
    * @return Curve parameters
    */
-  Params params_at(double progress) const override;
+  Params params_at(T progress) const override;
 
 private:
 
   // Line tangent
-  dvec3 _tan;
+  Vec3<T> _tan;
 };
 
 
 
-inline Line3d::Line3d(const dvec3& start, const dvec3& end)
-  : Curve3d(start, end)
+template <std::floating_point T>
+Line3d_t<T>::Line3d_t(const Vec3<T>& start, const Vec3<T>& end)
+  : Curve3d_t<T>(start, end)
   , _tan((end - start).make_normalized())
 {
 }
 
 
 
-inline dvec3 Line3d::position_at(double progress) const
+template <std::floating_point T>
+Vec3<T> Line3d_t<T>::position_at(T progress) const
 {
-  return _start + (_end - _start) * progress;
+  return this->_start + (this->_end - this->_start) * progress;
 }
 
 
 
-inline dvec3 Line3d::tangent_at(double progress) const
+template <std::floating_point T>
+Vec3<T> Line3d_t<T>::tangent_at(T progress) const
 {
   return _tan;
 }
 
 
 
-inline Curve3d::Params Line3d::params_at(double progress) const
+template <std::floating_point T>
+typename Line3d_t<T>::Params Line3d_t<T>::params_at(T progress) const
 {
   return {.position = position_at(progress), .tangent = _tan};
 }
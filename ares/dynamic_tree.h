@@ -0,0 +1,622 @@
+#ifndef __ARES_DYNAMIC_TREE_H__
+#define __ARES_DYNAMIC_TREE_H__
+
+#include "bbox3.h"
+#include "cull.h"
+#include "plane.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace ares
+{
+
+/**
+ * @brief Bounding volume tree over moving bounding boxes (proxies), updated incrementally. Leaves
+ * hold fattened boxes so that small moves do not change the tree, inserted leaves go down the
+ * branch that grows the tree surface area the least, and nodes on the way back up are rotated when
+ * their children heights differ by more than 1
+ */
+class Dynamic_tree
+{
+public:
+
+  // no node or proxy
+  static constexpr int32_t null = -1;
+
+  struct Node
+  {
+    // bounding box, fattened for leaves
+    Bbox3 box;
+    // parent node index, next free node index for free nodes
+    int32_t parent{null};
+    // first child node index, null for leaves
+    int32_t child1{null};
+    // second child node index, null for leaves
+    int32_t child2{null};
+    // height of the subtree, 0 for leaves, -1 for free nodes
+    int32_t height{-1};
+    // user value of leaves
+    int32_t user{null};
+  };
+
+  /**
+   * @brief C++ constructor
+   * @param margin Distance by which leaf boxes are fattened on each side
+   */
+  explicit Dynamic_tree(double margin = 0.1);
+
+  /**
+   * @brief Insert a proxy
+   * @param box Bounding box, must not be empty
+   * @param user User value reported by queries
+   * @return Proxy id
+   */
+  int32_t insert(const Bbox3& box, int32_t user);
+
+  /**
+   * @brief Remove a proxy
+   * @param proxy Proxy id
+   */
+  void remove(int32_t proxy);
+
+  /**
+   * @brief Move a proxy, nothing changes while the box stays inside the proxy fattened box, else
+   * the proxy is reinserted with a new fattened box
+   * @param proxy Proxy id
+   * @param box New bounding box, must not be empty
+   * @return True if the proxy was reinserted
+   */
+  bool move(int32_t proxy, const Bbox3& box);
+
+  /**
+   * @brief Get the user value of a proxy
+   * @param proxy Proxy id
+   * @return User value
+   */
+  int32_t user(int32_t proxy) const;
+
+  /**
+   * @brief Get the fattened bounding box of a proxy
+   * @param proxy Proxy id
+   * @return Fattened bounding box
+   */
+  const Bbox3& fat_box(int32_t proxy) const;
+
+  /**
+   * @brief Get all nodes, including free nodes
+   * @return Nodes
+   */
+  std::span<const Node> nodes() const;
+
+  /**
+   * @brief Get the root node index
+   * @return Root node index, null for an empty tree
+   */
+  int32_t root() const;
+
+  /**
+   * @brief Get the number of proxies
+   * @return Number of proxies
+   */
+  int32_t size() const;
+
+  /**
+   * @brief Get the tree height
+   * @return Height, 0 for a single proxy or an empty tree
+   */
+  int32_t height() const;
+
+  /**
+   * @brief Compute the surface area heuristic cost of the tree: the sum of the inner nodes surface
+   * areas divided by the root surface area, the expected number of inner nodes visited by a random
+   * query, lower is better
+   * @return Cost, 0 for an empty tree
+   */
+  double sah_cost() const;
+
+  /**
+   * @brief Visit the proxies inside or crossing a convex volume, nodes pass to their children the
+   * planes they are fully in front of so that these are not tested again, fattened boxes are tested
+   * @tparam F Visitor type
+   * @param planes Planes with normals pointing inside the volume, e.g. frustum planes from
+   * Frustum::compute_planes, not required to be normalized
+   * @param visit Called as visit(int32_t user, Visibility vis) for each proxy not outside
+   */
+  template <typename F>
+  void cull(const std::array<Plane, 6>& planes, F&& visit) const;
+
+  /**
+   * @brief Visit the proxies whose fattened box overlaps a bounding box
+   * @tparam F Visitor type
+   * @param box Bounding box to use
+   * @param visit Called as visit(int32_t user) for each overlapping proxy
+   */
+  template <typename F>
+  void query(const Bbox3& box, F&& visit) const;
+
+private:
+
+  /**
+   * @brief Allocate a node from the free list, grows the nodes if there is none
+   * @return Node index
+   */
+  int32_t allocate();
+
+  /**
+   * @brief Return a node to the free list
+   * @param index Node index
+   */
+  void release(int32_t index);
+
+  /**
+   * @brief Insert a leaf, next to the sibling that grows the tree surface area the least
+   * @param leaf Leaf node index
+   */
+  void insert_leaf(int32_t leaf);
+
+  /**
+   * @brief Remove a leaf, its sibling replaces their parent
+   * @param leaf Leaf node index
+   */
+  void remove_leaf(int32_t leaf);
+
+  /**
+   * @brief Balance and refit the nodes from the provided node up to the root
+   * @param index First node index
+   */
+  void refit(int32_t index);
+
+  /**
+   * @brief Rotate a node if its children heights differ by more than 1, the higher child takes
+   * its place and the node takes the lower grandchild
+   * @param index Node index
+   * @return Index of the node now in the place of the provided node
+   */
+  int32_t balance(int32_t index);
+
+  /**
+   * @brief Compute the bounding box of 2 bounding boxes
+   * @param a Bounding box to use
+   * @param b Bounding box to use
+   * @return Bounding box containing both
+   */
+  static Bbox3 merged(const Bbox3& a, const Bbox3& b);
+
+  /**
+   * @brief Compute the surface area of a bounding box
+   * @param box Bounding box to use, must not be empty
+   * @return Surface area
+   */
+  static double area(const Bbox3& box);
+
+  // max tree height supported by the traversal stacks, rotations keep the height close to log2(n)
+  static constexpr int32_t max_height = 64;
+
+  // nodes, free nodes are linked through their parent
+  std::vector<Node> _nodes;
+  // root node index
+  int32_t _root{null};
+  // first free node index
+  int32_t _free{null};
+  // number of proxies
+  int32_t _count{0};
+  // distance by which leaf boxes are fattened on each side
+  double _margin{0};
+};
+
+
+
+inline Dynamic_tree::Dynamic_tree(double margin) : _margin{margin}
+{
+}
+
+
+
+inline int32_t Dynamic_tree::insert(const Bbox3& box, int32_t user)
+{
+  const auto leaf = allocate();
+  const dvec3 margin{.x = _margin, .y = _margin, .z = _margin};
+  _nodes[leaf].box = {.min = box.min - margin, .max = box.max + margin};
+  _nodes[leaf].height = 0;
+  _nodes[leaf].user = user;
+  insert_leaf(leaf);
+  ++_count;
+  return leaf;
+}
+
+
+
+inline void Dynamic_tree::remove(int32_t proxy)
+{
+  remove_leaf(proxy);
+  release(proxy);
+  --_count;
+}
+
+
+
+inline bool Dynamic_tree::move(int32_t proxy, const Bbox3& box)
+{
+  const auto& fat = _nodes[proxy].box;
+  if (
+    fat.min.x <= box.min.x && fat.min.y <= box.min.y && fat.min.z <= box.min.z
+    && box.max.x <= fat.max.x && box.max.y <= fat.max.y && box.max.z <= fat.max.z)
+  {
+    return false;
+  }
+
+  remove_leaf(proxy);
+  const dvec3 margin{.x = _margin, .y = _margin, .z = _margin};
+  _nodes[proxy].box = {.min = box.min - margin, .max = box.max + margin};
+  insert_leaf(proxy);
+  return true;
+}
+
+
+
+inline int32_t Dynamic_tree::user(int32_t proxy) const
+{
+  return _nodes[proxy].user;
+}
+
+
+
+inline const Bbox3& Dynamic_tree::fat_box(int32_t proxy) const
+{
+  return _nodes[proxy].box;
+}
+
+
+
+inline std::span<const Dynamic_tree::Node> Dynamic_tree::nodes() const
+{
+  return _nodes;
+}
+
+
+
+inline int32_t Dynamic_tree::root() const
+{
+  return _root;
+}
+
+
+
+inline int32_t Dynamic_tree::size() const
+{
+  return _count;
+}
+
+
+
+inline int32_t Dynamic_tree::height() const
+{
+  return null == _root ? 0 : _nodes[_root].height;
+}
+
+
+
+inline double Dynamic_tree::sah_cost() const
+{
+  if (null == _root)
+  {
+    return 0;
+  }
+
+  double inner_area = 0;
+  for (const auto& node : _nodes)
+  {
+    if (node.height > 0)
+    {
+      inner_area += area(node.box);
+    }
+  }
+  const double root_area = area(_nodes[_root].box);
+  return root_area > 0 ? inner_area / root_area : 0;
+}
+
+
+
+template <typename F>
+void Dynamic_tree::cull(const std::array<Plane, 6>& planes, F&& visit) const
+{
+  if (null == _root)
+  {
+    return;
+  }
+
+  // nodes to visit with the mask of the planes that their parent crosses
+  struct Entry
+  {
+    int32_t node;
+    int32_t mask;
+  };
+  assert(height() <= max_height);
+  Entry stack[max_height + 2];
+  int32_t size = 0;
+  stack[size++] = {.node = _root, .mask = 0x3f};
+  while (size > 0)
+  {
+    const auto entry = stack[--size];
+    const auto& node = _nodes[entry.node];
+    const auto mask = 0 == entry.mask ? 0 : classify(node.box, planes, entry.mask);
+    if (mask < 0)
+    {
+      continue;
+    }
+
+    if (0 == node.height)
+    {
+      visit(node.user, 0 == mask ? Visibility::Inside : Visibility::Intersects);
+      continue;
+    }
+    stack[size++] = {.node = node.child1, .mask = mask};
+    stack[size++] = {.node = node.child2, .mask = mask};
+  }
+}
+
+
+
+template <typename F>
+void Dynamic_tree::query(const Bbox3& box, F&& visit) const
+{
+  if (null == _root)
+  {
+    return;
+  }
+
+  assert(height() <= max_height);
+  int32_t stack[max_height + 2];
+  int32_t size = 0;
+  stack[size++] = _root;
+  while (size > 0)
+  {
+    const auto& node = _nodes[stack[--size]];
+    if (!node.box.intersects(box))
+    {
+      continue;
+    }
+
+    if (0 == node.height)
+    {
+      visit(node.user);
+      continue;
+    }
+    stack[size++] = node.child1;
+    stack[size++] = node.child2;
+  }
+}
+
+
+
+inline int32_t Dynamic_tree::allocate()
+{
+  if (null == _free)
+  {
+    _nodes.emplace_back();
+    return static_cast<int32_t>(_nodes.size()) - 1;
+  }
+
+  const auto index = _free;
+  _free = _nodes[index].parent;
+  _nodes[index] = {};
+  return index;
+}
+
+
+
+inline void Dynamic_tree::release(int32_t index)
+{
+  _nodes[index] = {};
+  _nodes[index].parent = _free;
+  _free = index;
+}
+
+
+
+inline void Dynamic_tree::insert_leaf(int32_t leaf)
+{
+  if (null == _root)
+  {
+    _root = leaf;
+    _nodes[leaf].parent = null;
+    return;
+  }
+
+  // descend while pushing the leaf further down is cheaper than making it a sibling here, the
+  // cost is the area of the new parent plus the area growth of the ancestors
+  const auto leaf_box = _nodes[leaf].box;
+  auto index = _root;
+  while (_nodes[index].height > 0)
+  {
+    const auto& node = _nodes[index];
+    const double node_area = area(node.box);
+    const double combined_area = area(merged(node.box, leaf_box));
+    const double cost = 2 * combined_area;
+    const double inherited = 2 * (combined_area - node_area);
+    const auto child_cost = [&](int32_t child)
+    {
+      const auto& box = _nodes[child].box;
+      const double grown = area(merged(box, leaf_box));
+      return (0 == _nodes[child].height ? grown : grown - area(box)) + inherited;
+    };
+    const double cost1 = child_cost(node.child1);
+    const double cost2 = child_cost(node.child2);
+    if (cost < cost1 && cost < cost2)
+    {
+      break;
+    }
+    index = cost1 < cost2 ? node.child1 : node.child2;
+  }
+
+  // the new parent replaces the sibling
+  const auto sibling = index;
+  const auto old_parent = _nodes[sibling].parent;
+  const auto new_parent = allocate();
+  _nodes[new_parent].parent = old_parent;
+  _nodes[new_parent].box = merged(leaf_box, _nodes[sibling].box);
+  _nodes[new_parent].height = _nodes[sibling].height + 1;
+  _nodes[new_parent].child1 = sibling;
+  _nodes[new_parent].child2 = leaf;
+  _nodes[sibling].parent = new_parent;
+  _nodes[leaf].parent = new_parent;
+  if (null == old_parent)
+  {
+    _root = new_parent;
+  }
+  else if (_nodes[old_parent].child1 == sibling)
+  {
+    _nodes[old_parent].child1 = new_parent;
+  }
+  else
+  {
+    _nodes[old_parent].child2 = new_parent;
+  }
+
+  refit(_nodes[leaf].parent);
+}
+
+
+
+inline void Dynamic_tree::remove_leaf(int32_t leaf)
+{
+  if (leaf == _root)
+  {
+    _root = null;
+    return;
+  }
+
+  const auto parent = _nodes[leaf].parent;
+  const auto grand_parent = _nodes[parent].parent;
+  const auto sibling =
+    _nodes[parent].child1 == leaf ? _nodes[parent].child2 : _nodes[parent].child1;
+  _nodes[sibling].parent = grand_parent;
+  release(parent);
+  if (null == grand_parent)
+  {
+    _root = sibling;
+    return;
+  }
+
+  if (_nodes[grand_parent].child1 == parent)
+  {
+    _nodes[grand_parent].child1 = sibling;
+  }
+  else
+  {
+    _nodes[grand_parent].child2 = sibling;
+  }
+  refit(grand_parent);
+}
+
+
+
+inline void Dynamic_tree::refit(int32_t index)
+{
+  while (null != index)
+  {
+    index = balance(index);
+    auto& node = _nodes[index];
+    const auto& child1 = _nodes[node.child1];
+    const auto& child2 = _nodes[node.child2];
+    node.height = 1 + std::max(child1.height, child2.height);
+    node.box = merged(child1.box, child2.box);
+    index = node.parent;
+  }
+}
+
+
+
+inline int32_t Dynamic_tree::balance(int32_t index_a)
+{
+  auto& a = _nodes[index_a];
+  if (a.height < 2)
+  {
+    return index_a;
+  }
+
+  // a has children b and c, the higher one goes up and a takes its lower child
+  const auto index_b = a.child1;
+  const auto index_c = a.child2;
+  auto& b = _nodes[index_b];
+  auto& c = _nodes[index_c];
+  const auto diff = c.height - b.height;
+  if (diff >= -1 && diff <= 1)
+  {
+    return index_a;
+  }
+
+  const bool c_up = diff > 1;
+  const auto index_up = c_up ? index_c : index_b;
+  auto& up = c_up ? c : b;
+  auto& other = c_up ? b : c;
+
+  // the higher child takes the place of a
+  up.parent = a.parent;
+  a.parent = index_up;
+  if (null == up.parent)
+  {
+    _root = index_up;
+  }
+  else if (_nodes[up.parent].child1 == index_a)
+  {
+    _nodes[up.parent].child1 = index_up;
+  }
+  else
+  {
+    _nodes[up.parent].child2 = index_up;
+  }
+
+  // the higher grandchild stays under the moved up child, the lower one goes under a
+  const auto index_f = up.child1;
+  const auto index_g = up.child2;
+  const bool f_higher = _nodes[index_f].height > _nodes[index_g].height;
+  const auto index_keep = f_higher ? index_f : index_g;
+  const auto index_give = f_higher ? index_g : index_f;
+  auto& keep = _nodes[index_keep];
+  auto& give = _nodes[index_give];
+  up.child1 = index_a;
+  up.child2 = index_keep;
+  if (c_up)
+  {
+    a.child2 = index_give;
+  }
+  else
+  {
+    a.child1 = index_give;
+  }
+  give.parent = index_a;
+
+  a.box = merged(other.box, give.box);
+  a.height = 1 + std::max(other.height, give.height);
+  up.box = merged(a.box, keep.box);
+  up.height = 1 + std::max(a.height, keep.height);
+  return index_up;
+}
+
+
+
+inline Bbox3 Dynamic_tree::merged(const Bbox3& a, const Bbox3& b)
+{
+  Bbox3 box = a;
+  box.extend(b);
+  return box;
+}
+
+
+
+inline double Dynamic_tree::area(const Bbox3& box)
+{
+  const dvec3 size = box.max - box.min;
+  return 2 * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+} // namespace ares
+
+#endif //__ARES_DYNAMIC_TREE_H__
@@ -0,0 +1,233 @@
+#ifndef __ARES_FAST_H__
+#define __ARES_FAST_H__
+
+#include "concepts.h"
+#include "epsilon.h"
+#include "simd.h"
+#include "vec3.h"
+
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+
+/**
+ * @brief Approximate math, opt-in replacements for the precise functions used in hot loops. Each
+ * documents an error bound derived from its method, with margin over the max error measured by
+ * ares/tests/fast_test.cpp over the documented input range
+ */
+namespace ares::fast
+{
+
+/**
+ * @brief Approximate reciprocal square root, a hardware estimate refined by one Newton step, or
+ * without SSE a bit level estimate refined by two Newton steps. The hardware estimate is within
+ * 1.5 * 2^-12, after the Newton step the max relative error is 5e-7, and 6e-6 without SSE, the
+ * same for double which gains speed but not precision. Doubles outside of the normal float range
+ * fall back to 1 / std::sqrt. Tested over all valid values
+ * @tparam T Floating point type
+ * @param x Value, must be positive and for float also normal
+ * @return 1 / sqrt(x)
+ */
+template <std::floating_point T>
+T rsqrt(T x);
+
+/**
+ * @brief Approximate sine, the angle is reduced to [-pi/2, pi/2] and a degree 9 minimax
+ * polynomial, whose own error is 3.3e-9, is evaluated. Max absolute error 3e-7 for float and 5e-9
+ * for double, for angles in [-1e4, 1e4], past which the reduction adds up to 3e-16 * |rad|.
+ * Tested for angles in [-1e8, 1e8]
+ * @tparam T Floating point type
+ * @param rad Angle in radians
+ * @return sin(rad)
+ */
+template <std::floating_point T>
+T sin(T rad);
+
+/**
+ * @brief Approximate cosine, see sin for the method and error bounds
+ * @tparam T Floating point type
+ * @param rad Angle in radians
+ * @return cos(rad)
+ */
+template <std::floating_point T>
+T cos(T rad);
+
+/**
+ * @brief Integer power by repeated squaring, instead of std::pow. At most 1 rounding per
+ * multiplication, each within half an ulp, e.g. max relative error 6.0e-8 for the square of a
+ * float and 1.2e-7 for its cube, 1.1e-16 and 2.2e-16 for a double. Tested for all bases whose
+ * power is a normal value
+ * @tparam N Power, positive or zero
+ * @tparam T Arithmetic type
+ * @param x Value
+ * @return x to the power of N
+ */
+template <int N, arithmetic T>
+  requires(N >= 0)
+constexpr T pow(T x);
+
+/**
+ * @brief Normalize a vector with rsqrt, a multiplication instead of three divisions, zero length
+ * vectors are left as they are, see Vec3::normalize. Max error relative to the precise result 6e-7
+ * with SSE and 7e-6 without, the rsqrt error and the roundings of the length and products. Tested
+ * for lengths from 1e-10 up to where the squared length overflows
+ * @tparam T Floating point type
+ * @param v Vector to normalize
+ */
+template <std::floating_point T>
+void normalize(Vec3<T>& v);
+
+/**
+ * @brief Make a normalized vector with rsqrt, see normalize
+ * @tparam T Floating point type
+ * @param v Vector to normalize
+ * @return Normalized vector
+ */
+template <std::floating_point T>
+Vec3<T> make_normalized(const Vec3<T>& v);
+
+/**
+ * @brief Rotate a vector around an axis with the approximate sin and cos, see Vec3::rotate. Max
+ * error relative to the vector length 1e-6 for float and 1e-8 for double, twice the sin and cos
+ * error and the roundings of the products. Tested for angles in [-10, 10]
+ * @tparam T Floating point type
+ * @param v Vector to rotate
+ * @param norm_ax Axis to rotate around, must be normalized
+ * @param rad Angle to rotate by in radians
+ */
+template <std::floating_point T>
+void rotate(Vec3<T>& v, const Vec3<T>& norm_ax, T rad);
+
+
+
+template <std::floating_point T>
+T rsqrt(T x)
+{
+  // the estimate is made in float, for doubles outside of the normal float range it would be 0 or
+  // infinite
+  if constexpr (!std::same_as<T, float>)
+  {
+    if (x < std::numeric_limits<float>::min() || x > std::numeric_limits<float>::max())
+    {
+      return 1 / std::sqrt(x);
+    }
+  }
+
+  const auto xf = static_cast<float>(x);
+#if defined(ARES_SIMD_AVX) || defined(ARES_SIMD_SSE2)
+  // 12 bit estimate, one Newton step doubles the correct bits
+  T y = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(xf)));
+  return y * (T{1.5} - T{0.5} * x * y * y);
+#else
+  // the halved exponent and mantissa bits estimate is correct to 3 bits
+  T y = std::bit_cast<float>(0x5f375a86 - (std::bit_cast<int32_t>(xf) >> 1));
+  y *= T{1.5} - T{0.5} * x * y * y;
+  return y * (T{1.5} - T{0.5} * x * y * y);
+#endif
+}
+
+
+
+/**
+ * @brief Minimax polynomial of sin in [-pi/2, pi/2]
+ * @tparam T Floating point type
+ * @param r Reduced angle, in [-pi/2, pi/2]
+ * @return sin(r)
+ */
+template <std::floating_point T>
+T sin_poly(T r)
+{
+  const T r2 = r * r;
+  const T p = T(-0.00019800897763233964) + r2 * T(2.590488501367981e-06);
+  const T q = T(-0.1666664763464019) + r2 * (T(0.008332899823359278) + r2 * p);
+  return r * (T(0.9999999765898829) + r2 * q);
+}
+
+
+
+template <std::floating_point T>
+T sin(T rad)
+{
+  // rad = k pi + r with r in [-pi/2, pi/2], and sin(k pi + r) = (-1)^k sin(r), the reduction is in
+  // double so that float angles far from 0 keep their precision
+  const auto x = static_cast<double>(rad);
+  const auto k = static_cast<int64_t>(x * std::numbers::inv_pi + (x < 0 ? -0.5 : 0.5));
+  const auto r = static_cast<T>(x - static_cast<double>(k) * std::numbers::pi);
+  const T s = sin_poly(r);
+  return 0 == (k & 1) ? s : -s;
+}
+
+
+
+template <std::floating_point T>
+T cos(T rad)
+{
+  // rad = (k + 1/2) pi + r with r in [-pi/2, pi/2], and cos((k + 1/2) pi + r) = -(-1)^k sin(r)
+  const auto x = static_cast<double>(rad) - std::numbers::pi / 2;
+  const auto k = static_cast<int64_t>(x * std::numbers::inv_pi + (x < 0 ? -0.5 : 0.5));
+  const auto r = static_cast<T>(x - static_cast<double>(k) * std::numbers::pi);
+  const T s = sin_poly(r);
+  return 0 == (k & 1) ? -s : s;
+}
+
+
+
+template <int N, arithmetic T>
+  requires(N >= 0)
+constexpr T pow(T x)
+{
+  if constexpr (0 == N)
+  {
+    return 1;
+  }
+  else if constexpr (1 == N % 2)
+  {
+    return x * pow<N - 1>(x);
+  }
+  else
+  {
+    const T half = pow<N / 2>(x);
+    return half * half;
+  }
+}
+
+
+
+template <std::floating_point T>
+void normalize(Vec3<T>& v)
+{
+  if (const T len2 = v.dot(v); len2 >= static_cast<T>(deps * deps))
+  {
+    const T inv_len = rsqrt(len2);
+    v.x *= inv_len;
+    v.y *= inv_len;
+    v.z *= inv_len;
+  }
+}
+
+
+
+template <std::floating_point T>
+Vec3<T> make_normalized(const Vec3<T>& v)
+{
+  auto res = v;
+  normalize(res);
+  return res;
+}
+
+
+
+template <std::floating_point T>
+void rotate(Vec3<T>& v, const Vec3<T>& norm_ax, T rad)
+{
+  const T cost = cos(rad);
+  const T sint = sin(rad);
+  v = cost * v + sint * (norm_ax * v) + (1 - cost) * norm_ax.dot(v) * norm_ax;
+}
+
+} // namespace ares::fast
+
+#endif //__ARES_FAST_H__
@@ -1,6 +1,7 @@
 #ifndef __ARES_FRUSTUM_H__
 #define __ARES_FRUSTUM_H__
 
+#include "concepts.h"
 #include "cs3.h"
 #include "plane.h"
 
@@ -10,7 +11,18 @@
 namespace ares
 {
 
-struct Frustum
+template <std::floating_point T>
+struct Frustum_t;
+
+using Frustum = Frustum_t<double>;
+using Frustumf = Frustum_t<float>;
+
+/**
+ * @brief Perspective view frustum, looking along its cs x axis with the y axis up
+ * @tparam T Floating point type to use
+ */
+template <std::floating_point T>
+struct Frustum_t
 {
   /**
    * @brief Make frustum from parameters
@@ -20,14 +32,14 @@ struct Frustum
    * @param near Near distance
    * @param far Far distance
    */
-  static Frustum make(const dcs3& cs, double fov, double ratio, double near, double far);
+  static Frustum_t make(const Cs3<T>& cs, T fov, T ratio, T near, T far);
 
   /**
    * @brief Compute field of view half angle tangent
    * @param fov Field of view angle in radians
-   * @return double Computed value
+   * @return T Computed value
    */
-  static double from_fov(double fov);
+  static T from_fov(T fov);
 
   /**
    * @brief Set frustum perspective
@@ -36,50 +48,53 @@ struct Frustum
    * @param near Near distance
    * @param far Far distance
    */
-  void set_perspective(double fov, double ratio, double near, double far);
+  void set_perspective(T fov, T ratio, T near, T far);
 
   /**
    * @brief Check that point is contained
    * @param point Point to check
    * @return bool Result of check
    */
-  constexpr bool contains(const dvec3& point) const;
+  constexpr bool contains(const Vec3<T>& point) const;
 
   /**
    * @brief Compute frustum planes
-   * @return std::array<plane, 6> Frustum planes in order: near, far, bottom, top, left, right
+   * @return std::array<Plane_t, 6> Frustum planes in order: near, far, bottom, top, left, right
    */
-  constexpr std::array<Plane, 6> compute_planes() const;
+  constexpr std::array<Plane_t<T>, 6> compute_planes() const;
 
   // Coordinate system
-  dcs3 cs;
+  Cs3<T> cs;
   // Field of view half angle tangent
-  double fov_htan{0};
+  T fov_htan{0};
   // Aspect ratio
-  double ratio{0};
+  T ratio{0};
   // Near distance
-  double near{0};
+  T near{0};
   // Far distance
-  double far{0};
+  T far{0};
 };
 
 
 
-inline Frustum Frustum::make(const dcs3& cs, double fov, double ratio, double near, double far)
+template <std::floating_point T>
+Frustum_t<T> Frustum_t<T>::make(const Cs3<T>& cs, T fov, T ratio, T near, T far)
 {
   return {.cs = cs, .fov_htan = from_fov(fov), .ratio = ratio, .near = near, .far = far};
 }
 
 
 
-inline double Frustum::from_fov(double fov)
+template <std::floating_point T>
+T Frustum_t<T>::from_fov(T fov)
 {
-  return std::tan(fov * 0.5);
+  return std::tan(fov / 2);
 }
 
 
 
-inline void Frustum::set_perspective(double fov, double ratio, double near, double far)
+template <std::floating_point T>
+void Frustum_t<T>::set_perspective(T fov, T ratio, T near, T far)
 {
   fov_htan = from_fov(fov);
   this->ratio = ratio;
@@ -89,22 +104,23 @@ inline void Frustum::set_perspective(double fov, double ratio, double near, doub
 
 
 
-inline constexpr bool Frustum::contains(const dvec3& point) const
+template <std::floating_point T>
+constexpr bool Frustum_t<T>::contains(const Vec3<T>& point) const
 {
   bool result = false;
 
-  const dvec3 v = point - cs.origin;
-  const double x = v.dot(cs.x_axis);
+  const Vec3<T> v = point - cs.origin;
+  const T x = v.dot(cs.x_axis);
 
   if (near <= x && x <= far)
   {
-    const double y = v.dot(cs.y_axis);
-    const double half_hy = x * fov_htan;
+    const T y = v.dot(cs.y_axis);
+    const T half_hy = x * fov_htan;
 
     if (-half_hy <= y && y <= half_hy)
     {
-      const double z = v.dot(cs.z_axis);
-      const double half_wy = half_hy * ratio;
+      const T z = v.dot(cs.z_axis);
+      const T half_wy = half_hy * ratio;
 
       result = -half_wy <= z && z <= half_wy;
     }
@@ -115,16 +131,17 @@ inline constexpr bool Frustum::contains(const dvec3& point) const
 
 
 
-inline constexpr std::array<Plane, 6> Frustum::compute_planes() const
+template <std::floating_point T>
+constexpr std::array<Plane_t<T>, 6> Frustum_t<T>::compute_planes() const
 {
-  const dvec3 near_center = cs.origin + cs.x_axis * near;
-  const double half_hnear = fov_htan * near;
-  const double half_wnear = half_hnear * ratio;
-  const dvec3 front = near_center - cs.origin;
-  const dvec3 up = cs.y_axis * half_hnear;
-  const dvec3 right = cs.z_axis * half_wnear;
-
-  return {Plane{near_center, cs.x_axis},           // near plane
+  const Vec3<T> near_center = cs.origin + cs.x_axis * near;
+  const T half_hnear = fov_htan * near;
+  const T half_wnear = half_hnear * ratio;
+  const Vec3<T> front = near_center - cs.origin;
+  const Vec3<T> up = cs.y_axis * half_hnear;
+  const Vec3<T> right = cs.z_axis * half_wnear;
+
+  return {Plane_t<T>{near_center, cs.x_axis},      // near plane
     {cs.origin + cs.x_axis * far, cs.x_axis * -1}, // far plane
     {cs.origin, cs.z_axis * (front - up)},         // bottom plane
     {cs.origin, (front + up) * cs.z_axis},         // top plane
@@ -4,9 +4,15 @@
 #include "concepts.h"
 #include "cs3.h"
 #include "epsilon.h"
+#include "quat.h"
+#include "simd.h"
 #include "vec3.h"
 
 #include <algorithm>
+#include <cassert>
+#include <concepts>
+#include <span>
+#include <type_traits>
 
 namespace ares
 {
@@ -27,6 +33,32 @@ struct Matrix
    */
   static constexpr Matrix make_from(const Cs3<T>& cs);
 
+  /**
+   * @brief Make rotation matrix from quaternion
+   * @param rotation Rotation, must be normalized
+   * @return Matrix
+   */
+  static constexpr Matrix make_from(const Quat<T>& rotation);
+
+  /**
+   * @brief Make matrix from a matrix of another arithmetic type
+   * @tparam U Arithmetic type of the other matrix
+   * @param mx Matrix to convert
+   * @return Matrix
+   */
+  template <arithmetic U>
+  static constexpr Matrix make_from(const Matrix<U>& mx);
+
+  /**
+   * @brief Multiply a matrix by several matrices, e.g. a parent matrix by its children matrices,
+   * the SIMD kernel keeps the left matrix in registers for all products
+   * @param mx Left matrix
+   * @param mxs Right matrices
+   * @param res Resulting mx * mxs[i] matrices, same size as mxs, may be mxs
+   */
+  static constexpr void multiply(
+    const Matrix& mx, std::span<const Matrix> mxs, std::span<Matrix> res);
+
   /**
    * @brief Indexer operator
    * @param index Index from which to get an element
@@ -86,12 +118,32 @@ struct Matrix
    */
   constexpr Matrix make_inverse() const;
 
+  /**
+   * @brief Make the inverse of a rigid transform matrix, a rotation and a translation such as a
+   * matrix made from a cs, the rotation is transposed and the translation rotated back
+   * @return Resulting matrix
+   */
+  constexpr Matrix make_inverse_rigid() const;
+
+  /**
+   * @brief Make the inverse of an affine matrix, its last row is 0 0 0 1, only the 3x3 linear part
+   * is inverted
+   * @return Resulting matrix
+   */
+  constexpr Matrix make_inverse_affine() const;
+
   /**
    * @brief Set this matrix from the provided cs
    * @param cs Coordinate system to use
    */
   constexpr void set_from(const Cs3<T>& cs);
 
+  /**
+   * @brief Get the rotation of the upper left 3x3 part, the matrix must be rigid
+   * @return Quaternion
+   */
+  constexpr Quat<T> rotation() const;
+
   /**
    * @brief Set the provided point as origin as if the matrix is a coordinate system
    * @param origin Origin to set
@@ -141,6 +193,53 @@ constexpr Matrix<T> Matrix<T>::make_from(const Cs3<T>& cs)
 
 
 
+template <arithmetic T>
+constexpr Matrix<T> Matrix<T>::make_from(const Quat<T>& rotation)
+{
+  return make_from(Cs3<T>::make({}, rotation));
+}
+
+
+
+template <arithmetic T>
+template <arithmetic U>
+constexpr Matrix<T> Matrix<T>::make_from(const Matrix<U>& mx)
+{
+  Matrix m;
+  for (int i = 0; i < count; ++i)
+  {
+    m[i] = static_cast<T>(mx[i]);
+  }
+  return m;
+}
+
+
+
+template <arithmetic T>
+constexpr void Matrix<T>::multiply(
+  const Matrix& mx, std::span<const Matrix> mxs, std::span<Matrix> res)
+{
+  assert(mxs.size() == res.size());
+  if constexpr (std::floating_point<T>)
+  {
+    // the kernel takes the first matrix data, which an empty span does not have
+    if (!std::is_constant_evaluated() && !mxs.empty())
+    {
+      static_assert(sizeof(Matrix) == count * sizeof(T));
+      simd::mul_matrices(
+        mx.data, mxs.data()->data, res.data()->data, static_cast<int32_t>(mxs.size()));
+      return;
+    }
+  }
+
+  for (size_t i = 0; i < mxs.size(); ++i)
+  {
+    res[i] = mx * mxs[i];
+  }
+}
+
+
+
 template <arithmetic T>
 constexpr T& Matrix<T>::operator[](int index)
 {
@@ -161,6 +260,15 @@ template <arithmetic T>
 constexpr Matrix<T> Matrix<T>::operator*(const Matrix& mx) const
 {
   Matrix res;
+  if constexpr (std::floating_point<T>)
+  {
+    if (!std::is_constant_evaluated())
+    {
+      simd::mul_matrices(data, mx.data, res.data, 1);
+      return res;
+    }
+  }
+
   // 1st row
   res[0] = data[0] * mx[0] + data[4] * mx[1] + data[8] * mx[2] + data[12] * mx[3];
   res[1] = data[1] * mx[0] + data[5] * mx[1] + data[9] * mx[2] + data[13] * mx[3];
@@ -324,6 +432,45 @@ constexpr Matrix<T> Matrix<T>::make_inverse() const
 
 
 
+template <arithmetic T>
+constexpr Matrix<T> Matrix<T>::make_inverse_rigid() const
+{
+  // the inverse rotation rows are the rotation columns
+  const Vec3<T> x_axis{.x = data[0], .y = data[1], .z = data[2]};
+  const Vec3<T> y_axis{.x = data[4], .y = data[5], .z = data[6]};
+  const Vec3<T> z_axis{.x = data[8], .y = data[9], .z = data[10]};
+  const Vec3<T> origin{.x = data[12], .y = data[13], .z = data[14]};
+  return {
+    x_axis.x, y_axis.x, z_axis.x, 0, // 1st column
+    x_axis.y, y_axis.y, z_axis.y, 0, // 2nd column
+    x_axis.z, y_axis.z, z_axis.z, 0, // 3rd column
+    -x_axis.dot(origin), -y_axis.dot(origin), -z_axis.dot(origin), 1};
+}
+
+
+
+template <arithmetic T>
+constexpr Matrix<T> Matrix<T>::make_inverse_affine() const
+{
+  // the inverse linear part rows are the cross products of the other 2 columns over the
+  // determinant
+  const Vec3<T> x_axis{.x = data[0], .y = data[1], .z = data[2]};
+  const Vec3<T> y_axis{.x = data[4], .y = data[5], .z = data[6]};
+  const Vec3<T> z_axis{.x = data[8], .y = data[9], .z = data[10]};
+  const Vec3<T> origin{.x = data[12], .y = data[13], .z = data[14]};
+  const T inv_det = 1 / x_axis.dot(y_axis * z_axis);
+  const Vec3<T> row0 = y_axis * z_axis * inv_det;
+  const Vec3<T> row1 = z_axis * x_axis * inv_det;
+  const Vec3<T> row2 = x_axis * y_axis * inv_det;
+  return {
+    row0.x, row1.x, row2.x, 0, // 1st column
+    row0.y, row1.y, row2.y, 0, // 2nd column
+    row0.z, row1.z, row2.z, 0, // 3rd column
+    -row0.dot(origin), -row1.dot(origin), -row2.dot(origin), 1};
+}
+
+
+
 template <arithmetic T>
 constexpr void Matrix<T>::set_from(const Cs3<T>& cs)
 {
@@ -350,6 +497,17 @@ constexpr void Matrix<T>::set_from(const Cs3<T>& cs)
 
 
 
+template <arithmetic T>
+constexpr Quat<T> Matrix<T>::rotation() const
+{
+  return Quat<T>::make_from_axes(
+    {.x = data[0], .y = data[1], .z = data[2]},
+    {.x = data[4], .y = data[5], .z = data[6]},
+    {.x = data[8], .y = data[9], .z = data[10]});
+}
+
+
+
 template <arithmetic T>
 constexpr void Matrix<T>::set_origin(const Vec3<T>& origin)
 {
@@ -413,6 +571,16 @@ constexpr Vec3<T> Matrix<T>::transform_v(const Vec3<T>& v) const
 template <arithmetic T>
 constexpr Vec3<T> Matrix<T>::transform_p(const Vec3<T>& p) const
 {
+  if constexpr (std::floating_point<T>)
+  {
+    if (!std::is_constant_evaluated())
+    {
+      T res[3];
+      simd::transform_point(data, p.x, p.y, p.z, res);
+      return {.x = res[0], .y = res[1], .z = res[2]};
+    }
+  }
+
   return {
     .x = data[0] * p.x + data[4] * p.y + data[8] * p.z + data[12],
     .y = data[1] * p.x + data[5] * p.y + data[9] * p.z + data[13],
@@ -0,0 +1,287 @@
+#ifndef __ARES_MESH_H__
+#define __ARES_MESH_H__
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace ares
+{
+
+/**
+ * @brief Weld identical vertices so that faces share them through their indices, vertices are
+ * hashed and compared by their bytes
+ * @tparam V Vertex type, without padding bytes
+ * @param vertices Vertices to weld
+ * @param unique Unique vertices in the order of their first occurrence, cleared first
+ * @param remap Index in unique of each vertex, resized to the vertices count
+ */
+template <typename V>
+  requires std::is_trivially_copyable_v<V>
+void weld(std::span<const V> vertices, std::vector<V>& unique, std::vector<uint32_t>& remap);
+
+/**
+ * @brief Reorder the triangles of a triangle list for the post transform vertex cache with Tom
+ * Forsyth's linear speed algorithm: vertices are scored by their position in a simulated LRU cache
+ * and by their number of triangles left, and the triangle with the best vertex scores is emitted
+ * next, among the triangles of the cached vertices
+ * @param indices Triangle list indices, reordered in place, the triangles winding is kept
+ */
+void optimize_vertex_cache(std::span<uint32_t> indices);
+
+/**
+ * @brief Count the post transform vertex cache misses of a triangle list, simulated with a FIFO
+ * cache
+ * @param indices Triangle list indices
+ * @param cache_size Number of cache entries
+ * @return Misses, divided by the triangles count it is the average cache miss ratio (ACMR)
+ */
+int64_t cache_misses(std::span<const uint32_t> indices, int32_t cache_size = 16);
+
+
+
+template <typename V>
+  requires std::is_trivially_copyable_v<V>
+void weld(std::span<const V> vertices, std::vector<V>& unique, std::vector<uint32_t>& remap)
+{
+  constexpr uint32_t empty = std::numeric_limits<uint32_t>::max();
+  const auto hash = [](const V& v)
+  {
+    // FNV-1a over the vertex bytes
+    unsigned char bytes[sizeof(V)];
+    std::memcpy(bytes, &v, sizeof(V));
+    uint64_t h = 14695981039346656037ull;
+    for (const auto byte : bytes)
+    {
+      h = (h ^ byte) * 1099511628211ull;
+    }
+    return h;
+  };
+
+  // open addressing table of unique vertex indices, at most half full
+  const auto size = std::bit_ceil(std::max<size_t>(2 * vertices.size(), 1));
+  const auto mask = size - 1;
+  std::vector<uint32_t> table(size, empty);
+  unique.clear();
+  remap.resize(vertices.size());
+  for (size_t i = 0; i < vertices.size(); ++i)
+  {
+    const auto& v = vertices[i];
+    auto slot = hash(v) & mask;
+    while (empty != table[slot] && 0 != std::memcmp(&unique[table[slot]], &v, sizeof(V)))
+    {
+      slot = (slot + 1) & mask;
+    }
+    if (empty == table[slot])
+    {
+      table[slot] = static_cast<uint32_t>(unique.size());
+      unique.push_back(v);
+    }
+    remap[i] = table[slot];
+  }
+}
+
+
+
+inline void optimize_vertex_cache(std::span<uint32_t> indices)
+{
+  constexpr int32_t cache_size = 32;
+  const auto tri_count = static_cast<int32_t>(indices.size() / 3);
+  if (tri_count < 2)
+  {
+    return;
+  }
+
+  // vertices are numbered from the lowest index so that the state is sized to the indices span,
+  // which is compact for a part whose vertices were added together. Welded vertices shared with
+  // other triangle lists can be anywhere in the buffer, when the span is much larger than the
+  // triangles the vertices are numbered by their rank among the distinct indices instead
+  const auto [min, max] = std::minmax_element(indices.begin(), indices.end());
+  const auto base = *min;
+  std::vector<uint32_t> ids;
+  if (*max - base >= indices.size())
+  {
+    ids.assign(indices.begin(), indices.end());
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  }
+  const auto vertex_count = static_cast<int32_t>(ids.empty() ? *max - base + 1 : ids.size());
+  std::vector<int32_t> local(indices.size());
+  for (size_t i = 0; i < indices.size(); ++i)
+  {
+    local[i] = static_cast<int32_t>(
+      ids.empty() ? indices[i] - base
+                  : std::lower_bound(ids.begin(), ids.end(), indices[i]) - ids.begin());
+  }
+
+  // triangles of each vertex, the first remaining[v] entries are the triangles not emitted yet
+  std::vector<int32_t> remaining(vertex_count, 0);
+  for (const auto v : local)
+  {
+    ++remaining[v];
+  }
+  std::vector<int32_t> first(vertex_count + 1, 0);
+  for (int32_t v = 0; v < vertex_count; ++v)
+  {
+    first[v + 1] = first[v] + remaining[v];
+  }
+  std::vector<int32_t> tris(local.size());
+  std::vector<int32_t> fill(first.begin(), first.end() - 1);
+  for (size_t i = 0; i < local.size(); ++i)
+  {
+    tris[fill[local[i]]++] = static_cast<int32_t>(i / 3);
+  }
+
+  // scores of a vertex by cache position, the last triangle vertices score a bit less so that the
+  // next triangle does not reuse the same edge, and by its triangles left, to finish small fans
+  constexpr int32_t max_valence = 32;
+  std::array<float, cache_size> cache_scores;
+  std::array<float, max_valence> valence_scores;
+  for (int32_t i = 0; i < cache_size; ++i)
+  {
+    cache_scores[i] =
+      i < 3 ? 0.75f
+            : std::pow(1.0f - static_cast<float>(i - 3) / static_cast<float>(cache_size - 3), 1.5f);
+  }
+  for (int32_t i = 1; i < max_valence; ++i)
+  {
+    valence_scores[i] = 2.0f / std::sqrt(static_cast<float>(i));
+  }
+  const auto score_of = [&](int32_t cache_pos, int32_t left)
+  {
+    if (0 == left)
+    {
+      return -1.0f;
+    }
+    const float cache_score = cache_pos < 0 ? 0.0f : cache_scores[cache_pos];
+    return cache_score
+         + (left < max_valence ? valence_scores[left] : 2.0f / std::sqrt(static_cast<float>(left)));
+  };
+
+  std::vector<int32_t> cache_pos(vertex_count, -1);
+  std::vector<float> vertex_scores(vertex_count);
+  for (int32_t v = 0; v < vertex_count; ++v)
+  {
+    vertex_scores[v] = score_of(-1, remaining[v]);
+  }
+  const auto tri_score = [&](int32_t t)
+  {
+    return vertex_scores[local[3 * t]] + vertex_scores[local[3 * t + 1]]
+         + vertex_scores[local[3 * t + 2]];
+  };
+  std::vector<uint8_t> emitted(tri_count, 0);
+  int32_t best = 0;
+  float best_score = tri_score(0);
+  for (int32_t t = 1; t < tri_count; ++t)
+  {
+    const auto score = tri_score(t);
+    if (score > best_score)
+    {
+      best = t;
+      best_score = score;
+    }
+  }
+
+  std::vector<uint32_t> order;
+  order.reserve(indices.size());
+  std::array<int32_t, cache_size + 3> cache;
+  std::array<int32_t, cache_size + 3> next_cache;
+  int32_t cache_count = 0;
+  int32_t scan = 0;
+  for (int32_t n = 0; n < tri_count; ++n)
+  {
+    // no cached vertex has triangles left, continue with the next triangle not emitted
+    if (best < 0)
+    {
+      while (emitted[scan])
+      {
+        ++scan;
+      }
+      best = scan;
+    }
+
+    emitted[best] = 1;
+    const int32_t* corners = &local[3 * best];
+    for (int32_t c = 0; c < 3; ++c)
+    {
+      const auto v = corners[c];
+      order.push_back(ids.empty() ? base + v : ids[v]);
+      auto* begin = &tris[first[v]];
+      auto* end = begin + remaining[v];
+      std::iter_swap(std::find(begin, end, best), end - 1);
+      --remaining[v];
+    }
+
+    // the emitted triangle vertices move to the cache front, the others follow in order
+    int32_t next_count = 0;
+    for (int32_t c = 0; c < 3; ++c)
+    {
+      next_cache[next_count++] = corners[c];
+    }
+    for (int32_t i = 0; i < cache_count; ++i)
+    {
+      const auto v = cache[i];
+      if (v != corners[0] && v != corners[1] && v != corners[2])
+      {
+        next_cache[next_count++] = v;
+      }
+    }
+
+    // rescore the cache vertices, the ones past the cache size fall out, then their triangles
+    for (int32_t i = 0; i < next_count; ++i)
+    {
+      const auto v = next_cache[i];
+      cache_pos[v] = i < cache_size ? i : -1;
+      vertex_scores[v] = score_of(cache_pos[v], remaining[v]);
+    }
+    best = -1;
+    best_score = -1;
+    for (int32_t i = 0; i < next_count; ++i)
+    {
+      const auto v = next_cache[i];
+      for (int32_t j = first[v]; j < first[v] + remaining[v]; ++j)
+      {
+        const auto t = tris[j];
+        const auto score = tri_score(t);
+        if (score > best_score)
+        {
+          best = t;
+          best_score = score;
+        }
+      }
+    }
+    cache_count = std::min(next_count, cache_size);
+    std::copy_n(next_cache.begin(), cache_count, cache.begin());
+  }
+  std::copy(order.begin(), order.end(), indices.begin());
+}
+
+
+
+inline int64_t cache_misses(std::span<const uint32_t> indices, int32_t cache_size)
+{
+  std::vector<uint32_t> fifo(cache_size, std::numeric_limits<uint32_t>::max());
+  int32_t head = 0;
+  int64_t misses = 0;
+  for (const auto index : indices)
+  {
+    if (std::find(fifo.begin(), fifo.end(), index) == fifo.end())
+    {
+      ++misses;
+      fifo[head] = index;
+      head = (head + 1) % cache_size;
+    }
+  }
+  return misses;
+}
+
+} // namespace ares
+
+#endif //__ARES_MESH_H__
@@ -1,23 +1,32 @@
 #ifndef __ARES_PLANE_H__
 #define __ARES_PLANE_H__
 
+#include "concepts.h"
 #include "epsilon.h"
 #include "vec3.h"
 
 namespace ares
 {
 
+template <std::floating_point T>
+struct Plane_t;
+
+using Plane = Plane_t<double>;
+using Planef = Plane_t<float>;
+
 /**
  * @brief Geometric plane
+ * @tparam T Floating point type to use
  */
-struct Plane
+template <std::floating_point T>
+struct Plane_t
 {
   /**
    * @brief C++ constructor
    * @param pt Point on plane
    * @param norm Plane normal, must be normalized
    */
-  constexpr Plane(const dvec3& pt, const dvec3& norm);
+  constexpr Plane_t(const Vec3<T>& pt, const Vec3<T>& norm);
 
   /**
    * @brief C++ constructor
@@ -25,52 +34,54 @@ struct Plane
    * @param p1 Point on plane
    * @param p2 Point on plane
    */
-  constexpr Plane(const dvec3& p0, const dvec3& p1, const dvec3& p2);
+  constexpr Plane_t(const Vec3<T>& p0, const Vec3<T>& p1, const Vec3<T>& p2);
 
   /**
    * @brief Adjust plane for a new position and normal
    * @param pt Point to use in adjustment
    */
-  constexpr void adjust(const dvec3& pt);
+  constexpr void adjust(const Vec3<T>& pt);
 
   /**
    * @brief Compute distance from plane to point. Negative if point is on the back side of the plane
    * @param point Point to use
    * @return Distance to point. Negative if on the back side
    */
-  constexpr double distance(const dvec3& point) const;
+  constexpr T distance(const Vec3<T>& point) const;
 
   /**
    * @brief Check if point is on this plane
    * @param point Point to check
    * @return Result of check
    */
-  constexpr bool contains(const dvec3& point) const;
+  constexpr bool contains(const Vec3<T>& point) const;
 
   /**
    * @brief Project point on this plane
    * @param point Point to project
    * @return Projected point
    */
-  constexpr dvec3 project(const dvec3& point) const;
+  constexpr Vec3<T> project(const Vec3<T>& point) const;
 
   // Plane normal, must be normalized. Adjust plane if changed
-  dvec3 normal{.y = 1};
+  Vec3<T> normal{.y = 1};
 
   // Plane D coefficient
-  double d{0};
+  T d{0};
 };
 
 
 
-inline constexpr Plane::Plane(const dvec3& pt, const dvec3& norm) : normal{norm}
+template <std::floating_point T>
+constexpr Plane_t<T>::Plane_t(const Vec3<T>& pt, const Vec3<T>& norm) : normal{norm}
 {
   adjust(pt);
 }
 
 
 
-inline constexpr Plane::Plane(const dvec3& p0, const dvec3& p1, const dvec3& p2)
+template <std::floating_point T>
+constexpr Plane_t<T>::Plane_t(const Vec3<T>& p0, const Vec3<T>& p1, const Vec3<T>& p2)
   : normal(((p1 - p0) * (p2 - p0)).make_normalized())
 {
   adjust(p0);
@@ -78,28 +89,32 @@ inline constexpr Plane::Plane(const dvec3& p0, const dvec3& p1, const dvec3& p2)
 
 
 
-inline constexpr void Plane::adjust(const dvec3& pt)
+template <std::floating_point T>
+constexpr void Plane_t<T>::adjust(const Vec3<T>& pt)
 {
   d = -normal.dot(pt);
 }
 
 
 
-inline constexpr double Plane::distance(const dvec3& point) const
+template <std::floating_point T>
+constexpr T Plane_t<T>::distance(const Vec3<T>& point) const
 {
   return normal.dot(point) + d;
 }
 
 
 
-inline constexpr bool Plane::contains(const dvec3& point) const
+template <std::floating_point T>
+constexpr bool Plane_t<T>::contains(const Vec3<T>& point) const
 {
   return zero(distance(point));
 }
 
 
 
-inline constexpr dvec3 Plane::project(const dvec3& point) const
+template <std::floating_point T>
+constexpr Vec3<T> Plane_t<T>::project(const Vec3<T>& point) const
 {
   return point - normal * distance(point);
 }
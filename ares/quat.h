@@ -0,0 +1,326 @@
+#ifndef __ARES_QUAT_H__
+#define __ARES_QUAT_H__
+
+#include "epsilon.h"
+#include "simd.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+
+namespace ares
+{
+
+template <std::floating_point T>
+struct Quat;
+
+using dquat = Quat<double>;
+using fquat = Quat<float>;
+
+/**
+ * @brief Rotation quaternion, composing rotations costs a quaternion product and renormalizing
+ * it keeps the rotation free of drift, unlike repeatedly rotated axes
+ * @tparam T Floating point type to use
+ */
+template <std::floating_point T>
+struct Quat
+{
+  /**
+   * @brief Make rotation around an axis
+   * @param norm_ax Axis to rotate around, must be normalized
+   * @param rad Angle in radians
+   * @return Quaternion
+   */
+  static constexpr Quat make_from(const Vec3<T>& norm_ax, T rad);
+
+  /**
+   * @brief Make rotation that takes the world axes to the provided axes
+   * @param x_axis X axis, must be normalized
+   * @param y_axis Y axis, must be normalized
+   * @param z_axis Z axis, must be normalized and complete a right handed cs
+   * @return Quaternion
+   */
+  static constexpr Quat make_from_axes(
+    const Vec3<T>& x_axis, const Vec3<T>& y_axis, const Vec3<T>& z_axis);
+
+  /**
+   * @brief Normalized linear interpolation, along the shortest arc, cheaper than slerp but the
+   * angular speed is not constant
+   * @param from Rotation at 0
+   * @param to Rotation at 1
+   * @param t Interpolation parameter between 0 and 1
+   * @return Quaternion
+   */
+  static constexpr Quat nlerp(const Quat& from, const Quat& to, T t);
+
+  /**
+   * @brief Spherical linear interpolation, along the shortest arc with constant angular speed
+   * @param from Rotation at 0
+   * @param to Rotation at 1
+   * @param t Interpolation parameter between 0 and 1
+   * @return Quaternion
+   */
+  static constexpr Quat slerp(const Quat& from, const Quat& to, T t);
+
+  /**
+   * @brief Composition operator, the result applies q first then this rotation
+   * @param q Quaternion by which to multiply
+   * @return Resulting quaternion
+   */
+  constexpr Quat operator*(const Quat& q) const;
+
+  /**
+   * @brief Composition assignment operator
+   * @param q Quaternion by which to multiply
+   */
+  constexpr void operator*=(const Quat& q);
+
+  /**
+   * @brief Dot product of the quaternions
+   * @param q Quaternion to use in dot product
+   * @return T Result of operation
+   */
+  constexpr T dot(const Quat& q) const;
+
+  /**
+   * @brief Make conjugate, the inverse rotation of a normalized quaternion
+   * @return Resulting quaternion
+   */
+  constexpr Quat conjugate() const;
+
+  /**
+   * @brief Normalize the quaternion, length becomes 1
+   */
+  constexpr void normalize();
+
+  /**
+   * @brief Rotate the provided vector
+   * @param v Vector to rotate
+   * @return Rotated vector
+   */
+  constexpr Vec3<T> rotate(const Vec3<T>& v) const;
+
+  /**
+   * @brief Rotate several vectors, the quaternion is converted to a 3x3 matrix once and the
+   * vectors are rotated by a SIMD kernel
+   * @param vs Vectors to rotate
+   * @param res Rotated vectors, same size as vs, may be vs
+   */
+  void rotate(std::span<const Vec3<T>> vs, std::span<Vec3<T>> res) const;
+
+  /**
+   * @brief Get the rotated world axes, the columns of the rotation matrix
+   * @param x_axis Rotated x axis
+   * @param y_axis Rotated y axis
+   * @param z_axis Rotated z axis
+   */
+  constexpr void to_axes(Vec3<T>& x_axis, Vec3<T>& y_axis, Vec3<T>& z_axis) const;
+
+  T x{0};
+  T y{0};
+  T z{0};
+  T w{1}; // identity by default, must be normalized to represent a rotation
+};
+
+
+
+template <std::floating_point T>
+constexpr Quat<T> Quat<T>::make_from(const Vec3<T>& norm_ax, T rad)
+{
+  const T sinh = std::sin(rad / 2);
+  return {
+    .x = norm_ax.x * sinh, .y = norm_ax.y * sinh, .z = norm_ax.z * sinh, .w = std::cos(rad / 2)};
+}
+
+
+
+template <std::floating_point T>
+constexpr Quat<T> Quat<T>::make_from_axes(
+  const Vec3<T>& x_axis, const Vec3<T>& y_axis, const Vec3<T>& z_axis)
+{
+  // from the rotation matrix whose columns are the axes, the largest of w, x, y, z is computed
+  // from the diagonal and the others from the off diagonal sums and differences
+  const T trace = x_axis.x + y_axis.y + z_axis.z;
+  if (trace > 0)
+  {
+    const T r = std::sqrt(trace + 1);
+    const T s = T{0.5} / r;
+    return {
+      .x = (y_axis.z - z_axis.y) * s,
+      .y = (z_axis.x - x_axis.z) * s,
+      .z = (x_axis.y - y_axis.x) * s,
+      .w = r / 2};
+  }
+  if (x_axis.x > y_axis.y && x_axis.x > z_axis.z)
+  {
+    const T r = std::sqrt(1 + x_axis.x - y_axis.y - z_axis.z);
+    const T s = T{0.5} / r;
+    return {
+      .x = r / 2,
+      .y = (y_axis.x + x_axis.y) * s,
+      .z = (z_axis.x + x_axis.z) * s,
+      .w = (y_axis.z - z_axis.y) * s};
+  }
+  if (y_axis.y > z_axis.z)
+  {
+    const T r = std::sqrt(1 + y_axis.y - x_axis.x - z_axis.z);
+    const T s = T{0.5} / r;
+    return {
+      .x = (y_axis.x + x_axis.y) * s,
+      .y = r / 2,
+      .z = (z_axis.y + y_axis.z) * s,
+      .w = (z_axis.x - x_axis.z) * s};
+  }
+  const T r = std::sqrt(1 + z_axis.z - x_axis.x - y_axis.y);
+  const T s = T{0.5} / r;
+  return {
+    .x = (z_axis.x + x_axis.z) * s,
+    .y = (z_axis.y + y_axis.z) * s,
+    .z = r / 2,
+    .w = (x_axis.y - y_axis.x) * s};
+}
+
+
+
+template <std::floating_point T>
+constexpr Quat<T> Quat<T>::nlerp(const Quat& from, const Quat& to, T t)
+{
+  // q and -q are the same rotation, the one closer to from gives the shortest arc
+  const T wt = from.dot(to) < 0 ? -t : t;
+  const T wf = 1 - t;
+  Quat q{
+    .x = wf * from.x + wt * to.x,
+    .y = wf * from.y + wt * to.y,
+    .z = wf * from.z + wt * to.z,
+    .w = wf * from.w + wt * to.w};
+  q.normalize();
+  return q;
+}
+
+
+
+template <std::floating_point T>
+constexpr Quat<T> Quat<T>::slerp(const Quat& from, const Quat& to, T t)
+{
+  const T cos = from.dot(to);
+  const T abs_cos = std::abs(cos);
+  // nearly identical rotations, the arc is a line
+  if (abs_cos > 1 - deps)
+  {
+    return nlerp(from, to, t);
+  }
+
+  const T angle = std::acos(abs_cos);
+  const T inv_sin = 1 / std::sqrt(1 - abs_cos * abs_cos);
+  const T wf = std::sin((1 - t) * angle) * inv_sin;
+  const T wt = std::sin(t * angle) * inv_sin * (cos < 0 ? -1 : 1);
+  return {
+    .x = wf * from.x + wt * to.x,
+    .y = wf * from.y + wt * to.y,
+    .z = wf * from.z + wt * to.z,
+    .w = wf * from.w + wt * to.w};
+}
+
+
+
+template <std::floating_point T>
+constexpr Quat<T> Quat<T>::operator*(const Quat& q) const
+{
+  return {
+    .x = w * q.x + x * q.w + y * q.z - z * q.y,
+    .y = w * q.y - x * q.z + y * q.w + z * q.x,
+    .z = w * q.z + x * q.y - y * q.x + z * q.w,
+    .w = w * q.w - x * q.x - y * q.y - z * q.z};
+}
+
+
+
+template <std::floating_point T>
+constexpr void Quat<T>::operator*=(const Quat& q)
+{
+  *this = *this * q;
+}
+
+
+
+template <std::floating_point T>
+constexpr T Quat<T>::dot(const Quat& q) const
+{
+  return x * q.x + y * q.y + z * q.z + w * q.w;
+}
+
+
+
+template <std::floating_point T>
+constexpr Quat<T> Quat<T>::conjugate() const
+{
+  return {.x = -x, .y = -y, .z = -z, .w = w};
+}
+
+
+
+template <std::floating_point T>
+constexpr void Quat<T>::normalize()
+{
+  if (const T len = std::sqrt(dot(*this)); !zero(len))
+  {
+    const T inv_len = 1 / len;
+    x *= inv_len;
+    y *= inv_len;
+    z *= inv_len;
+    w *= inv_len;
+  }
+}
+
+
+
+template <std::floating_point T>
+constexpr Vec3<T> Quat<T>::rotate(const Vec3<T>& v) const
+{
+  // v + 2w (u x v) + 2u x (u x v), with u the vector part
+  const Vec3<T> u{.x = x, .y = y, .z = z};
+  const auto t = u * v * T{2};
+  return v + t * w + u * t;
+}
+
+
+
+template <std::floating_point T>
+void Quat<T>::rotate(std::span<const Vec3<T>> vs, std::span<Vec3<T>> res) const
+{
+  assert(vs.size() == res.size());
+  static_assert(sizeof(Vec3<T>) == 3 * sizeof(T));
+  if (vs.empty())
+  {
+    return;
+  }
+  Vec3<T> x_axis, y_axis, z_axis;
+  to_axes(x_axis, y_axis, z_axis);
+  const T rows[9] = {
+    x_axis.x, y_axis.x, z_axis.x, // 1st row
+    x_axis.y, y_axis.y, z_axis.y, // 2nd row
+    x_axis.z, y_axis.z, z_axis.z}; // 3rd row
+  simd::rotate_vectors(rows, &vs.data()->x, &res.data()->x, static_cast<int32_t>(vs.size()));
+}
+
+
+
+template <std::floating_point T>
+constexpr void Quat<T>::to_axes(Vec3<T>& x_axis, Vec3<T>& y_axis, Vec3<T>& z_axis) const
+{
+  const T xx = x * x, yy = y * y, zz = z * z;
+  const T xy = x * y, xz = x * z, yz = y * z;
+  const T wx = w * x, wy = w * y, wz = w * z;
+  x_axis = {.x = 1 - 2 * (yy + zz), .y = 2 * (xy + wz), .z = 2 * (xz - wy)};
+  y_axis = {.x = 2 * (xy - wz), .y = 1 - 2 * (xx + zz), .z = 2 * (yz + wx)};
+  z_axis = {.x = 2 * (xz + wy), .y = 2 * (yz - wx), .z = 1 - 2 * (xx + yy)};
+}
+
+} // namespace ares
+
+#endif //__ARES_QUAT_H__
@@ -0,0 +1,93 @@
+#ifndef __ARES_RADIX_SORT_H__
+#define __ARES_RADIX_SORT_H__
+
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace ares
+{
+
+/**
+ * @brief Stable LSD radix sort of items by an unsigned integer key, one byte per pass. Passes where
+ * all keys share the same byte value are skipped
+ * @tparam T Item type
+ * @tparam K Key function type, returns an unsigned integer key for an item
+ * @param items Items to sort, sorted on return
+ * @param scratch Scratch buffer reused between calls, resized to the items size
+ * @param key Key function
+ */
+template <typename T, typename K>
+  requires std::unsigned_integral<std::invoke_result_t<K, const T&>>
+void radix_sort(std::vector<T>& items, std::vector<T>& scratch, K key);
+
+/**
+ * @brief Map a float to an unsigned key with the same ordering, usable as a radix sort key.
+ * Negative values have all bits flipped, positive values only the sign bit
+ * @param value Value to map, must not be NaN
+ * @return Ordered key
+ */
+constexpr uint32_t float_key(float value);
+
+
+
+template <typename T, typename K>
+  requires std::unsigned_integral<std::invoke_result_t<K, const T&>>
+void radix_sort(std::vector<T>& items, std::vector<T>& scratch, K key)
+{
+  using Key = std::invoke_result_t<K, const T&>;
+  constexpr int passes = sizeof(Key);
+
+  // histograms for all passes are computed in a single run over the items
+  std::array<std::array<uint32_t, 256>, passes> counts{};
+  for (const auto& item : items)
+  {
+    const Key k = key(item);
+    for (int pass = 0; pass < passes; ++pass)
+    {
+      ++counts[pass][(k >> (pass * 8)) & 0xff];
+    }
+  }
+
+  scratch.resize(items.size());
+  const auto size = static_cast<uint32_t>(items.size());
+  for (int pass = 0; pass < passes; ++pass)
+  {
+    auto& count = counts[pass];
+    const Key byte = items.empty() ? 0 : (key(items.front()) >> (pass * 8)) & 0xff;
+    if (count[byte] == size)
+    {
+      continue;
+    }
+
+    // turn counts into output offsets
+    uint32_t offset = 0;
+    for (auto& c : count)
+    {
+      const uint32_t n = c;
+      c = offset;
+      offset += n;
+    }
+
+    for (const auto& item : items)
+    {
+      scratch[count[(key(item) >> (pass * 8)) & 0xff]++] = item;
+    }
+    items.swap(scratch);
+  }
+}
+
+
+
+constexpr uint32_t float_key(float value)
+{
+  const auto bits = std::bit_cast<uint32_t>(value);
+  return bits ^ ((bits & 0x80000000u) ? 0xffffffffu : 0x80000000u);
+}
+
+} // namespace ares
+
+#endif //__ARES_RADIX_SORT_H__
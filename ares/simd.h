@@ -0,0 +1,1355 @@
+#ifndef __ARES_SIMD_H__
+#define __ARES_SIMD_H__
+
+// instruction set selected at compile time, AVX when enabled by the compiler flags, else SSE2 which
+// is always available on x64, else scalar
+#if defined(__AVX__)
+#define ARES_SIMD_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ARES_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+namespace ares::simd
+{
+
+// pack of doubles, as wide as the selected instruction set allows
+struct dpack
+{
+#if defined(ARES_SIMD_AVX)
+  // number of doubles in a pack
+  static constexpr int size = 4;
+  // packed values
+  __m256d v;
+#elif defined(ARES_SIMD_SSE2)
+  // number of doubles in a pack
+  static constexpr int size = 2;
+  // packed values
+  __m128d v;
+#else
+  // number of doubles in a pack
+  static constexpr int size = 1;
+  // packed value
+  double v;
+#endif
+};
+
+// pack of floats, as wide as the selected instruction set allows
+struct fpack
+{
+#if defined(ARES_SIMD_AVX)
+  // number of floats in a pack
+  static constexpr int size = 8;
+  // packed values
+  __m256 v;
+#elif defined(ARES_SIMD_SSE2)
+  // number of floats in a pack
+  static constexpr int size = 4;
+  // packed values
+  __m128 v;
+#else
+  // number of floats in a pack
+  static constexpr int size = 1;
+  // packed value
+  float v;
+#endif
+};
+
+// pack of the provided floating point type
+template <typename T>
+using pack = std::conditional_t<std::is_same_v<T, float>, fpack, dpack>;
+
+// mask with a bit set for each value of a pack
+template <typename P>
+constexpr int full_mask = (1 << P::size) - 1;
+
+/**
+ * @brief Allocator aligned to the widest pack, for arrays streamed by SIMD kernels
+ * @tparam T Value type
+ */
+template <typename T>
+struct Aligned_allocator
+{
+  // allocated value type
+  using value_type = T;
+  // alignment of the allocations, the AVX register size
+  static constexpr std::align_val_t alignment{32};
+
+  /**
+   * @brief Default constructor
+   */
+  Aligned_allocator() = default;
+
+  /**
+   * @brief Rebind constructor
+   * @tparam U Value type of the other allocator
+   * @param other Allocator to copy
+   */
+  template <typename U>
+  constexpr Aligned_allocator(const Aligned_allocator<U>& other);
+
+  /**
+   * @brief Allocate aligned memory
+   * @param count Number of values
+   * @return Allocated memory
+   */
+  T* allocate(size_t count);
+
+  /**
+   * @brief Free memory returned by allocate
+   * @param p Memory to free
+   * @param count Number of values
+   */
+  void deallocate(T* p, size_t count);
+
+  /**
+   * @brief Equality operator, all allocators are interchangeable
+   * @tparam U Value type of the other allocator
+   * @param other Allocator to compare with
+   * @return bool Result of comparison
+   */
+  template <typename U>
+  constexpr bool operator==(const Aligned_allocator<U>& other) const;
+};
+
+/**
+ * @brief Load a pack from memory, no alignment required
+ * @param p Values to load, dpack::size values
+ * @return Loaded pack
+ */
+dpack load(const double* p);
+
+/**
+ * @brief Store a pack to memory, no alignment required
+ * @param p Destination, dpack::size values
+ * @param a Pack to store
+ */
+void store(double* p, dpack a);
+
+/**
+ * @brief Make a pack with all values set to the provided value
+ * @param a Value to use
+ * @return Pack
+ */
+dpack broadcast(double a);
+
+/**
+ * @brief Add packs
+ * @param a Pack to use
+ * @param b Pack to use
+ * @return Per value a + b
+ */
+dpack operator+(dpack a, dpack b);
+
+/**
+ * @brief Subtract packs
+ * @param a Pack to use
+ * @param b Pack to use
+ * @return Per value a - b
+ */
+dpack operator-(dpack a, dpack b);
+
+/**
+ * @brief Multiply packs
+ * @param a Pack to use
+ * @param b Pack to use
+ * @return Per value a * b
+ */
+dpack operator*(dpack a, dpack b);
+
+/**
+ * @brief Divide packs
+ * @param a Pack to use
+ * @param b Pack to use
+ * @return Per value a / b
+ */
+dpack operator/(dpack a, dpack b);
+
+/**
+ * @brief Multiply and add packs, fused when FMA is enabled
+ * @param a Pack to use
+ * @param b Pack to use
+ * @param c Pack to use
+ * @return Per value a * b + c
+ */
+dpack mul_add(dpack a, dpack b, dpack c);
+
+/**
+ * @brief Absolute values of a pack
+ * @param a Pack to use
+ * @return Per value |a|
+ */
+dpack abs(dpack a);
+
+/**
+ * @brief Square roots of a pack
+ * @param a Pack to use
+ * @return Per value sqrt(a)
+ */
+dpack sqrt(dpack a);
+
+/**
+ * @brief Minimum of packs
+ * @param a Pack to use
+ * @param b Pack to use
+ * @return Per value min(a, b)
+ */
+dpack min(dpack a, dpack b);
+
+/**
+ * @brief Maximum of packs
+ * @param a Pack to use
+ * @param b Pack to use
+ * @return Per value max(a, b)
+ */
+dpack max(dpack a, dpack b);
+
+/**
+ * @brief Compare packs
+ * @param a Pack to use
+ * @param b Pack to use
+ * @return Mask with bit i set if a[i] < b[i]
+ */
+int less(dpack a, dpack b);
+
+/**
+ * @brief Load a pack from memory, no alignment required
+ * @param p Values to load, fpack::size values
+ * @return Loaded pack
+ */
+fpack load(const float* p);
+
+/**
+ * @brief Store a pack to memory, no alignment required
+ * @param p Destination, fpack::size values
+ * @param a Pack to store
+ */
+void store(float* p, fpack a);
+
+/**
+ * @brief Make a pack with all values set to the provided value
+ * @param a Value to use
+ * @return Pack
+ */
+fpack broadcast(float a);
+
+/**
+ * @brief Add packs
+ * @param a Pack to use
+ * @param b Pack to use
+ * @return Per value a + b
+ */
+fpack operator+(fpack a, fpack b);
+
+/**
+ * @brief Subtract packs
+ * @param a Pack to use
+ * @param b Pack to use
+ * @return Per value a - b
+ */
+fpack operator-(fpack a, fpack b);
+
+/**
+ * @brief Multiply packs
+ * @param a Pack to use
+ * @param b Pack to use
+ * @return Per value a * b
+ */
+fpack operator*(fpack a, fpack b);
+
+/**
+ * @brief Divide packs
+ * @param a Pack to use
+ * @param b Pack to use
+ * @return Per value a / b
+ */
+fpack operator/(fpack a, fpack b);
+
+/**
+ * @brief Multiply and add packs, fused when FMA is enabled
+ * @param a Pack to use
+ * @param b Pack to use
+ * @param c Pack to use
+ * @return Per value a * b + c
+ */
+fpack mul_add(fpack a, fpack b, fpack c);
+
+/**
+ * @brief Absolute values of a pack
+ * @param a Pack to use
+ * @return Per value |a|
+ */
+fpack abs(fpack a);
+
+/**
+ * @brief Square roots of a pack
+ * @param a Pack to use
+ * @return Per value sqrt(a)
+ */
+fpack sqrt(fpack a);
+
+/**
+ * @brief Minimum of packs
+ * @param a Pack to use
+ * @param b Pack to use
+ * @return Per value min(a, b)
+ */
+fpack min(fpack a, fpack b);
+
+/**
+ * @brief Maximum of packs
+ * @param a Pack to use
+ * @param b Pack to use
+ * @return Per value max(a, b)
+ */
+fpack max(fpack a, fpack b);
+
+/**
+ * @brief Compare packs
+ * @param a Pack to use
+ * @param b Pack to use
+ * @return Mask with bit i set if a[i] < b[i]
+ */
+int less(fpack a, fpack b);
+
+/**
+ * @brief Multiply a column major 4x4 matrix by several others, the left matrix stays in registers
+ * @param a Left matrix, 16 values
+ * @param b Right matrices, 16 values each
+ * @param res Resulting matrices a * b[i], 16 values each, may be a or b
+ * @param count Number of right matrices
+ */
+void mul_matrices(const double* a, const double* b, double* res, int32_t count);
+
+/**
+ * @brief Multiply a column major 4x4 matrix by several others, the left matrix stays in registers
+ * @param a Left matrix, 16 values
+ * @param b Right matrices, 16 values each
+ * @param res Resulting matrices a * b[i], 16 values each, may be a or b
+ * @param count Number of right matrices
+ */
+void mul_matrices(const float* a, const float* b, float* res, int32_t count);
+
+/**
+ * @brief Transform a point by a column major 4x4 matrix, the last row is ignored
+ * @param m Matrix, 16 values
+ * @param x Point x
+ * @param y Point y
+ * @param z Point z
+ * @param res Transformed point, 3 values
+ */
+void transform_point(const double* m, double x, double y, double z, double* res);
+
+/**
+ * @brief Transform a point by a column major 4x4 matrix, the last row is ignored
+ * @param m Matrix, 16 values
+ * @param x Point x
+ * @param y Point y
+ * @param z Point z
+ * @param res Transformed point, 3 values
+ */
+void transform_point(const float* m, float x, float y, float z, float* res);
+
+/**
+ * @brief Compose a row major 3x4 affine transform with several others, as a * b[i] where the
+ * missing last rows are 0 0 0 1
+ * @param a Left transform, 12 values
+ * @param b Right transforms, 12 values each
+ * @param res Resulting transforms, 12 values each, may be a or b
+ * @param count Number of right transforms
+ */
+void compose_affines(const float* a, const float* b, float* res, int32_t count);
+
+/**
+ * @brief Multiply 3 value vectors by a row major 3x3 matrix, e.g. a rotation, the vectors are
+ * transposed in registers to x, y and z packs so each value is used once per matrix row
+ * @param m Matrix, 9 values
+ * @param v Vectors, 3 values each
+ * @param res Resulting vectors, 3 values each, may be v
+ * @param count Number of vectors
+ */
+void rotate_vectors(const double* m, const double* v, double* res, int32_t count);
+
+/**
+ * @brief Multiply 3 value vectors by a row major 3x3 matrix, e.g. a rotation, the vectors are
+ * transposed in registers to x, y and z packs so each value is used once per matrix row
+ * @param m Matrix, 9 values
+ * @param v Vectors, 3 values each
+ * @param res Resulting vectors, 3 values each, may be v
+ * @param count Number of vectors
+ */
+void rotate_vectors(const float* m, const float* v, float* res, int32_t count);
+
+/**
+ * @brief Matrix kernels for packs of at most 4 values, a matrix column is split in 4 / P::size
+ * packs and each right matrix value is broadcast to multiply a left matrix column
+ * @tparam P Pack type
+ */
+template <typename P>
+struct Matrix_kernels
+{
+  // value type of the pack
+  using T = std::conditional_t<std::is_same_v<P, fpack>, float, double>;
+  // packs per matrix column
+  static constexpr int n = 4 / P::size;
+
+  /**
+   * @brief Multiply a column major 4x4 matrix by several others, see mul_matrices
+   * @param a Left matrix, 16 values
+   * @param b Right matrices, 16 values each
+   * @param res Resulting matrices a * b[i], 16 values each, may be a or b
+   * @param count Number of right matrices
+   */
+  static void mul_matrices(const T* a, const T* b, T* res, int32_t count);
+
+  /**
+   * @brief Transform a point by a column major 4x4 matrix, see transform_point
+   * @param m Matrix, 16 values
+   * @param x Point x
+   * @param y Point y
+   * @param z Point z
+   * @param res Transformed point, 3 values
+   */
+  static void transform_point(const T* m, T x, T y, T z, T* res);
+
+  /**
+   * @brief Multiply a left matrix by a right matrix column
+   * @param cols Left matrix columns
+   * @param b Right matrix column, 4 values
+   * @param res Resulting column
+   */
+  static void mul_column(const P (&cols)[4][n], const T* b, P (&res)[n]);
+};
+
+
+
+#if defined(ARES_SIMD_AVX)
+
+inline dpack load(const double* p)
+{
+  return {_mm256_loadu_pd(p)};
+}
+
+
+
+inline void store(double* p, dpack a)
+{
+  _mm256_storeu_pd(p, a.v);
+}
+
+
+
+inline dpack broadcast(double a)
+{
+  return {_mm256_set1_pd(a)};
+}
+
+
+
+inline dpack operator+(dpack a, dpack b)
+{
+  return {_mm256_add_pd(a.v, b.v)};
+}
+
+
+
+inline dpack operator-(dpack a, dpack b)
+{
+  return {_mm256_sub_pd(a.v, b.v)};
+}
+
+
+
+inline dpack operator*(dpack a, dpack b)
+{
+  return {_mm256_mul_pd(a.v, b.v)};
+}
+
+
+
+inline dpack operator/(dpack a, dpack b)
+{
+  return {_mm256_div_pd(a.v, b.v)};
+}
+
+
+
+inline dpack mul_add(dpack a, dpack b, dpack c)
+{
+#if defined(__FMA__)
+  return {_mm256_fmadd_pd(a.v, b.v, c.v)};
+#else
+  return {_mm256_add_pd(_mm256_mul_pd(a.v, b.v), c.v)};
+#endif
+}
+
+
+
+inline dpack abs(dpack a)
+{
+  return {_mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v)};
+}
+
+
+
+inline dpack sqrt(dpack a)
+{
+  return {_mm256_sqrt_pd(a.v)};
+}
+
+
+
+inline dpack min(dpack a, dpack b)
+{
+  return {_mm256_min_pd(a.v, b.v)};
+}
+
+
+
+inline dpack max(dpack a, dpack b)
+{
+  return {_mm256_max_pd(a.v, b.v)};
+}
+
+
+
+inline int less(dpack a, dpack b)
+{
+  return _mm256_movemask_pd(_mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ));
+}
+
+
+
+inline fpack load(const float* p)
+{
+  return {_mm256_loadu_ps(p)};
+}
+
+
+
+inline void store(float* p, fpack a)
+{
+  _mm256_storeu_ps(p, a.v);
+}
+
+
+
+inline fpack broadcast(float a)
+{
+  return {_mm256_set1_ps(a)};
+}
+
+
+
+inline fpack operator+(fpack a, fpack b)
+{
+  return {_mm256_add_ps(a.v, b.v)};
+}
+
+
+
+inline fpack operator-(fpack a, fpack b)
+{
+  return {_mm256_sub_ps(a.v, b.v)};
+}
+
+
+
+inline fpack operator*(fpack a, fpack b)
+{
+  return {_mm256_mul_ps(a.v, b.v)};
+}
+
+
+
+inline fpack operator/(fpack a, fpack b)
+{
+  return {_mm256_div_ps(a.v, b.v)};
+}
+
+
+
+inline fpack mul_add(fpack a, fpack b, fpack c)
+{
+#if defined(__FMA__)
+  return {_mm256_fmadd_ps(a.v, b.v, c.v)};
+#else
+  return {_mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v)};
+#endif
+}
+
+
+
+inline fpack abs(fpack a)
+{
+  return {_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)};
+}
+
+
+
+inline fpack sqrt(fpack a)
+{
+  return {_mm256_sqrt_ps(a.v)};
+}
+
+
+
+inline fpack min(fpack a, fpack b)
+{
+  return {_mm256_min_ps(a.v, b.v)};
+}
+
+
+
+inline fpack max(fpack a, fpack b)
+{
+  return {_mm256_max_ps(a.v, b.v)};
+}
+
+
+
+inline int less(fpack a, fpack b)
+{
+  return _mm256_movemask_ps(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ));
+}
+
+#elif defined(ARES_SIMD_SSE2)
+
+inline dpack load(const double* p)
+{
+  return {_mm_loadu_pd(p)};
+}
+
+
+
+inline void store(double* p, dpack a)
+{
+  _mm_storeu_pd(p, a.v);
+}
+
+
+
+inline dpack broadcast(double a)
+{
+  return {_mm_set1_pd(a)};
+}
+
+
+
+inline dpack operator+(dpack a, dpack b)
+{
+  return {_mm_add_pd(a.v, b.v)};
+}
+
+
+
+inline dpack operator-(dpack a, dpack b)
+{
+  return {_mm_sub_pd(a.v, b.v)};
+}
+
+
+
+inline dpack operator*(dpack a, dpack b)
+{
+  return {_mm_mul_pd(a.v, b.v)};
+}
+
+
+
+inline dpack operator/(dpack a, dpack b)
+{
+  return {_mm_div_pd(a.v, b.v)};
+}
+
+
+
+inline dpack mul_add(dpack a, dpack b, dpack c)
+{
+  return {_mm_add_pd(_mm_mul_pd(a.v, b.v), c.v)};
+}
+
+
+
+inline dpack abs(dpack a)
+{
+  return {_mm_andnot_pd(_mm_set1_pd(-0.0), a.v)};
+}
+
+
+
+inline dpack sqrt(dpack a)
+{
+  return {_mm_sqrt_pd(a.v)};
+}
+
+
+
+inline dpack min(dpack a, dpack b)
+{
+  return {_mm_min_pd(a.v, b.v)};
+}
+
+
+
+inline dpack max(dpack a, dpack b)
+{
+  return {_mm_max_pd(a.v, b.v)};
+}
+
+
+
+inline int less(dpack a, dpack b)
+{
+  return _mm_movemask_pd(_mm_cmplt_pd(a.v, b.v));
+}
+
+
+
+inline fpack load(const float* p)
+{
+  return {_mm_loadu_ps(p)};
+}
+
+
+
+inline void store(float* p, fpack a)
+{
+  _mm_storeu_ps(p, a.v);
+}
+
+
+
+inline fpack broadcast(float a)
+{
+  return {_mm_set1_ps(a)};
+}
+
+
+
+inline fpack operator+(fpack a, fpack b)
+{
+  return {_mm_add_ps(a.v, b.v)};
+}
+
+
+
+inline fpack operator-(fpack a, fpack b)
+{
+  return {_mm_sub_ps(a.v, b.v)};
+}
+
+
+
+inline fpack operator*(fpack a, fpack b)
+{
+  return {_mm_mul_ps(a.v, b.v)};
+}
+
+
+
+inline fpack operator/(fpack a, fpack b)
+{
+  return {_mm_div_ps(a.v, b.v)};
+}
+
+
+
+inline fpack mul_add(fpack a, fpack b, fpack c)
+{
+  return {_mm_add_ps(_mm_mul_ps(a.v, b.v), c.v)};
+}
+
+
+
+inline fpack abs(fpack a)
+{
+  return {_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)};
+}
+
+
+
+inline fpack sqrt(fpack a)
+{
+  return {_mm_sqrt_ps(a.v)};
+}
+
+
+
+inline fpack min(fpack a, fpack b)
+{
+  return {_mm_min_ps(a.v, b.v)};
+}
+
+
+
+inline fpack max(fpack a, fpack b)
+{
+  return {_mm_max_ps(a.v, b.v)};
+}
+
+
+
+inline int less(fpack a, fpack b)
+{
+  return _mm_movemask_ps(_mm_cmplt_ps(a.v, b.v));
+}
+
+#else
+
+inline dpack load(const double* p)
+{
+  return {*p};
+}
+
+
+
+inline void store(double* p, dpack a)
+{
+  *p = a.v;
+}
+
+
+
+inline dpack broadcast(double a)
+{
+  return {a};
+}
+
+
+
+inline dpack operator+(dpack a, dpack b)
+{
+  return {a.v + b.v};
+}
+
+
+
+inline dpack operator-(dpack a, dpack b)
+{
+  return {a.v - b.v};
+}
+
+
+
+inline dpack operator*(dpack a, dpack b)
+{
+  return {a.v * b.v};
+}
+
+
+
+inline dpack operator/(dpack a, dpack b)
+{
+  return {a.v / b.v};
+}
+
+
+
+inline dpack mul_add(dpack a, dpack b, dpack c)
+{
+  return {a.v * b.v + c.v};
+}
+
+
+
+inline dpack abs(dpack a)
+{
+  return {std::abs(a.v)};
+}
+
+
+
+inline dpack sqrt(dpack a)
+{
+  return {std::sqrt(a.v)};
+}
+
+
+
+inline dpack min(dpack a, dpack b)
+{
+  return {b.v < a.v ? b.v : a.v};
+}
+
+
+
+inline dpack max(dpack a, dpack b)
+{
+  return {a.v < b.v ? b.v : a.v};
+}
+
+
+
+inline int less(dpack a, dpack b)
+{
+  return a.v < b.v ? 1 : 0;
+}
+
+
+
+inline fpack load(const float* p)
+{
+  return {*p};
+}
+
+
+
+inline void store(float* p, fpack a)
+{
+  *p = a.v;
+}
+
+
+
+inline fpack broadcast(float a)
+{
+  return {a};
+}
+
+
+
+inline fpack operator+(fpack a, fpack b)
+{
+  return {a.v + b.v};
+}
+
+
+
+inline fpack operator-(fpack a, fpack b)
+{
+  return {a.v - b.v};
+}
+
+
+
+inline fpack operator*(fpack a, fpack b)
+{
+  return {a.v * b.v};
+}
+
+
+
+inline fpack operator/(fpack a, fpack b)
+{
+  return {a.v / b.v};
+}
+
+
+
+inline fpack mul_add(fpack a, fpack b, fpack c)
+{
+  return {a.v * b.v + c.v};
+}
+
+
+
+inline fpack abs(fpack a)
+{
+  return {std::abs(a.v)};
+}
+
+
+
+inline fpack sqrt(fpack a)
+{
+  return {std::sqrt(a.v)};
+}
+
+
+
+inline fpack min(fpack a, fpack b)
+{
+  return {b.v < a.v ? b.v : a.v};
+}
+
+
+
+inline fpack max(fpack a, fpack b)
+{
+  return {a.v < b.v ? b.v : a.v};
+}
+
+
+
+inline int less(fpack a, fpack b)
+{
+  return a.v < b.v ? 1 : 0;
+}
+
+#endif
+
+
+
+template <typename T>
+template <typename U>
+constexpr Aligned_allocator<T>::Aligned_allocator(const Aligned_allocator<U>&)
+{
+}
+
+
+
+template <typename T>
+inline T* Aligned_allocator<T>::allocate(size_t count)
+{
+  return static_cast<T*>(::operator new(count * sizeof(T), alignment));
+}
+
+
+
+template <typename T>
+inline void Aligned_allocator<T>::deallocate(T* p, size_t count)
+{
+  ::operator delete(p, count * sizeof(T), alignment);
+}
+
+
+
+template <typename T>
+template <typename U>
+constexpr bool Aligned_allocator<T>::operator==(const Aligned_allocator<U>&) const
+{
+  return true;
+}
+
+
+
+template <typename P>
+inline void Matrix_kernels<P>::mul_matrices(const T* a, const T* b, T* res, int32_t count)
+{
+  P cols[4][n];
+  for (int k = 0; k < 4; ++k)
+  {
+    for (int r = 0; r < n; ++r)
+    {
+      cols[k][r] = load(a + 4 * k + r * P::size);
+    }
+  }
+
+  for (int32_t i = 0; i < count; ++i, b += 16, res += 16)
+  {
+    // compute the whole matrix before writing, the result may be the right matrix
+    P col0[n];
+    P col1[n];
+    P col2[n];
+    P col3[n];
+    mul_column(cols, b, col0);
+    mul_column(cols, b + 4, col1);
+    mul_column(cols, b + 8, col2);
+    mul_column(cols, b + 12, col3);
+    for (int r = 0; r < n; ++r)
+    {
+      store(res + r * P::size, col0[r]);
+      store(res + 4 + r * P::size, col1[r]);
+      store(res + 8 + r * P::size, col2[r]);
+      store(res + 12 + r * P::size, col3[r]);
+    }
+  }
+}
+
+
+
+template <typename P>
+inline void Matrix_kernels<P>::mul_column(const P (&cols)[4][n], const T* b, P (&res)[n])
+{
+  const P b0 = broadcast(b[0]);
+  const P b1 = broadcast(b[1]);
+  const P b2 = broadcast(b[2]);
+  const P b3 = broadcast(b[3]);
+  for (int r = 0; r < n; ++r)
+  {
+    const P col01 = mul_add(cols[1][r], b1, cols[0][r] * b0);
+    res[r] = mul_add(cols[3][r], b3, mul_add(cols[2][r], b2, col01));
+  }
+}
+
+
+
+template <typename P>
+inline void Matrix_kernels<P>::transform_point(const T* m, T x, T y, T z, T* res)
+{
+  T col[4];
+  for (int r = 0; r < n; ++r)
+  {
+    const auto offset = r * P::size;
+    const P origin = load(m + 12 + offset);
+    const P xyz = mul_add(
+      load(m + 8 + offset),
+      broadcast(z),
+      mul_add(load(m + 4 + offset), broadcast(y), mul_add(load(m + offset), broadcast(x), origin)));
+    store(col + offset, xyz);
+  }
+  res[0] = col[0];
+  res[1] = col[1];
+  res[2] = col[2];
+}
+
+
+
+inline void mul_matrices(const double* a, const double* b, double* res, int32_t count)
+{
+  Matrix_kernels<dpack>::mul_matrices(a, b, res, count);
+}
+
+
+
+inline void mul_matrices(const float* a, const float* b, float* res, int32_t count)
+{
+#if defined(ARES_SIMD_AVX)
+  // a pack holds 2 result columns, each half multiplies a left column copy by its right column
+  // values broadcast inside the half
+  __m256 cols[4];
+  for (int k = 0; k < 4; ++k)
+  {
+    cols[k] = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 4 * k));
+  }
+  for (int32_t i = 0; i < 16 * count; i += 8)
+  {
+    const __m256 pair = _mm256_loadu_ps(b + i);
+    const fpack b0{_mm256_shuffle_ps(pair, pair, 0x00)};
+    const fpack b1{_mm256_shuffle_ps(pair, pair, 0x55)};
+    const fpack b2{_mm256_shuffle_ps(pair, pair, 0xaa)};
+    const fpack b3{_mm256_shuffle_ps(pair, pair, 0xff)};
+    const fpack col01 = mul_add(fpack{cols[1]}, b1, fpack{cols[0]} * b0);
+    store(res + i, mul_add(fpack{cols[3]}, b3, mul_add(fpack{cols[2]}, b2, col01)));
+  }
+#else
+  Matrix_kernels<fpack>::mul_matrices(a, b, res, count);
+#endif
+}
+
+
+
+inline void transform_point(const double* m, double x, double y, double z, double* res)
+{
+  Matrix_kernels<dpack>::transform_point(m, x, y, z, res);
+}
+
+
+
+inline void transform_point(const float* m, float x, float y, float z, float* res)
+{
+#if defined(ARES_SIMD_AVX)
+  // a matrix column fits half a pack, use the 128 bit instructions
+#if defined(__FMA__)
+  const __m128 xyz = _mm_fmadd_ps(
+    _mm_loadu_ps(m + 8),
+    _mm_set1_ps(z),
+    _mm_fmadd_ps(
+      _mm_loadu_ps(m + 4),
+      _mm_set1_ps(y),
+      _mm_fmadd_ps(_mm_loadu_ps(m), _mm_set1_ps(x), _mm_loadu_ps(m + 12))));
+#else
+  const __m128 xyz = _mm_add_ps(
+    _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(m), _mm_set1_ps(x)), _mm_loadu_ps(m + 12)),
+    _mm_add_ps(
+      _mm_mul_ps(_mm_loadu_ps(m + 4), _mm_set1_ps(y)),
+      _mm_mul_ps(_mm_loadu_ps(m + 8), _mm_set1_ps(z))));
+#endif
+  float col[4];
+  _mm_storeu_ps(col, xyz);
+  res[0] = col[0];
+  res[1] = col[1];
+  res[2] = col[2];
+#else
+  Matrix_kernels<fpack>::transform_point(m, x, y, z, res);
+#endif
+}
+
+
+
+inline void compose_affines(const float* a, const float* b, float* res, int32_t count)
+{
+#if defined(ARES_SIMD_AVX) || defined(ARES_SIMD_SSE2)
+  // a row fits 4 floats, use the 128 bit instructions, each result row is the right rows weighted
+  // by the left row values plus the left row translation
+  const auto mul_add = [](__m128 x, __m128 y, __m128 z)
+  {
+#if defined(__FMA__)
+    return _mm_fmadd_ps(x, y, z);
+#else
+    return _mm_add_ps(_mm_mul_ps(x, y), z);
+#endif
+  };
+  const __m128 translation = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+  const __m128 a0 = _mm_loadu_ps(a);
+  const __m128 a1 = _mm_loadu_ps(a + 4);
+  const __m128 a2 = _mm_loadu_ps(a + 8);
+  const __m128 a00 = _mm_shuffle_ps(a0, a0, 0x00);
+  const __m128 a01 = _mm_shuffle_ps(a0, a0, 0x55);
+  const __m128 a02 = _mm_shuffle_ps(a0, a0, 0xaa);
+  const __m128 a10 = _mm_shuffle_ps(a1, a1, 0x00);
+  const __m128 a11 = _mm_shuffle_ps(a1, a1, 0x55);
+  const __m128 a12 = _mm_shuffle_ps(a1, a1, 0xaa);
+  const __m128 a20 = _mm_shuffle_ps(a2, a2, 0x00);
+  const __m128 a21 = _mm_shuffle_ps(a2, a2, 0x55);
+  const __m128 a22 = _mm_shuffle_ps(a2, a2, 0xaa);
+  const __m128 t0 = _mm_and_ps(a0, translation);
+  const __m128 t1 = _mm_and_ps(a1, translation);
+  const __m128 t2 = _mm_and_ps(a2, translation);
+  for (int32_t i = 0; i < count; ++i, b += 12, res += 12)
+  {
+    const __m128 b0 = _mm_loadu_ps(b);
+    const __m128 b1 = _mm_loadu_ps(b + 4);
+    const __m128 b2 = _mm_loadu_ps(b + 8);
+    _mm_storeu_ps(res, mul_add(a02, b2, mul_add(a01, b1, mul_add(a00, b0, t0))));
+    _mm_storeu_ps(res + 4, mul_add(a12, b2, mul_add(a11, b1, mul_add(a10, b0, t1))));
+    _mm_storeu_ps(res + 8, mul_add(a22, b2, mul_add(a21, b1, mul_add(a20, b0, t2))));
+  }
+#else
+  const float left[12] = {
+    a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8], a[9], a[10], a[11]};
+  for (int32_t i = 0; i < count; ++i, b += 12, res += 12)
+  {
+    float rows[12];
+    for (int r = 0; r < 3; ++r)
+    {
+      const float* row = left + 4 * r;
+      for (int c = 0; c < 4; ++c)
+      {
+        rows[4 * r + c] = row[0] * b[c] + row[1] * b[4 + c] + row[2] * b[8 + c];
+      }
+      rows[4 * r + 3] += row[3];
+    }
+    std::copy_n(rows, 12, res);
+  }
+#endif
+}
+
+
+
+/**
+ * @brief Multiply vectors by a row major 3x3 matrix without SIMD, see rotate_vectors
+ * @tparam T Value type
+ * @param m Matrix, 9 values
+ * @param v Vectors, 3 values each
+ * @param res Resulting vectors, 3 values each, may be v
+ * @param count Number of vectors
+ */
+template <typename T>
+inline void rotate_vectors_scalar(const T* m, const T* v, T* res, int32_t count)
+{
+  for (int32_t i = 0; i < count; ++i, v += 3, res += 3)
+  {
+    const T x = v[0];
+    const T y = v[1];
+    const T z = v[2];
+    res[0] = m[0] * x + m[1] * y + m[2] * z;
+    res[1] = m[3] * x + m[4] * y + m[5] * z;
+    res[2] = m[6] * x + m[7] * y + m[8] * z;
+  }
+}
+
+
+
+inline void rotate_vectors(const double* m, const double* v, double* res, int32_t count)
+{
+  int32_t i = 0;
+#if defined(ARES_SIMD_AVX) || defined(ARES_SIMD_SSE2)
+  // 2 vectors fit 3 128 bit registers, the 256 bit ones would need lane crossing shuffles
+  const auto mul_add = [](__m128d x, __m128d y, __m128d z)
+  {
+#if defined(__FMA__)
+    return _mm_fmadd_pd(x, y, z);
+#else
+    return _mm_add_pd(_mm_mul_pd(x, y), z);
+#endif
+  };
+  const __m128d m0 = _mm_set1_pd(m[0]);
+  const __m128d m1 = _mm_set1_pd(m[1]);
+  const __m128d m2 = _mm_set1_pd(m[2]);
+  const __m128d m3 = _mm_set1_pd(m[3]);
+  const __m128d m4 = _mm_set1_pd(m[4]);
+  const __m128d m5 = _mm_set1_pd(m[5]);
+  const __m128d m6 = _mm_set1_pd(m[6]);
+  const __m128d m7 = _mm_set1_pd(m[7]);
+  const __m128d m8 = _mm_set1_pd(m[8]);
+  for (; i + 2 <= count; i += 2, v += 6, res += 6)
+  {
+    // x0 y0 | z0 x1 | y1 z1
+    const __m128d v0 = _mm_loadu_pd(v);
+    const __m128d v1 = _mm_loadu_pd(v + 2);
+    const __m128d v2 = _mm_loadu_pd(v + 4);
+    const __m128d x = _mm_shuffle_pd(v0, v1, 2);
+    const __m128d y = _mm_shuffle_pd(v0, v2, 1);
+    const __m128d z = _mm_shuffle_pd(v1, v2, 2);
+    const __m128d rx = mul_add(m2, z, mul_add(m1, y, _mm_mul_pd(m0, x)));
+    const __m128d ry = mul_add(m5, z, mul_add(m4, y, _mm_mul_pd(m3, x)));
+    const __m128d rz = mul_add(m8, z, mul_add(m7, y, _mm_mul_pd(m6, x)));
+    _mm_storeu_pd(res, _mm_unpacklo_pd(rx, ry));
+    _mm_storeu_pd(res + 2, _mm_shuffle_pd(rz, rx, 2));
+    _mm_storeu_pd(res + 4, _mm_unpackhi_pd(ry, rz));
+  }
+#endif
+  rotate_vectors_scalar(m, v, res, count - i);
+}
+
+
+
+inline void rotate_vectors(const float* m, const float* v, float* res, int32_t count)
+{
+  int32_t i = 0;
+#if defined(ARES_SIMD_AVX) || defined(ARES_SIMD_SSE2)
+  // 4 vectors fit 3 128 bit registers, the 256 bit ones would need lane crossing shuffles
+  const auto mul_add = [](__m128 x, __m128 y, __m128 z)
+  {
+#if defined(__FMA__)
+    return _mm_fmadd_ps(x, y, z);
+#else
+    return _mm_add_ps(_mm_mul_ps(x, y), z);
+#endif
+  };
+  // gather the even lanes of a then of b, as a0 a2 b0 b2
+  const auto pairs = [](__m128 a, __m128 b)
+  {
+    return _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+  };
+  const __m128 m0 = _mm_set1_ps(m[0]);
+  const __m128 m1 = _mm_set1_ps(m[1]);
+  const __m128 m2 = _mm_set1_ps(m[2]);
+  const __m128 m3 = _mm_set1_ps(m[3]);
+  const __m128 m4 = _mm_set1_ps(m[4]);
+  const __m128 m5 = _mm_set1_ps(m[5]);
+  const __m128 m6 = _mm_set1_ps(m[6]);
+  const __m128 m7 = _mm_set1_ps(m[7]);
+  const __m128 m8 = _mm_set1_ps(m[8]);
+  for (; i + 4 <= count; i += 4, v += 12, res += 12)
+  {
+    // x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+    const __m128 a = _mm_loadu_ps(v);
+    const __m128 b = _mm_loadu_ps(v + 4);
+    const __m128 c = _mm_loadu_ps(v + 8);
+    const __m128 x = _mm_shuffle_ps(
+      a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 3, 2)), _MM_SHUFFLE(3, 0, 3, 0));
+    const __m128 y = pairs(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+      _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)));
+    const __m128 z = pairs(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+      _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)));
+    const __m128 rx = mul_add(m2, z, mul_add(m1, y, _mm_mul_ps(m0, x)));
+    const __m128 ry = mul_add(m5, z, mul_add(m4, y, _mm_mul_ps(m3, x)));
+    const __m128 rz = mul_add(m8, z, mul_add(m7, y, _mm_mul_ps(m6, x)));
+    _mm_storeu_ps(res,
+      pairs(_mm_shuffle_ps(rx, ry, _MM_SHUFFLE(0, 0, 0, 0)),
+        _mm_shuffle_ps(rz, rx, _MM_SHUFFLE(1, 1, 0, 0))));
+    _mm_storeu_ps(res + 4,
+      pairs(_mm_shuffle_ps(ry, rz, _MM_SHUFFLE(1, 1, 1, 1)),
+        _mm_shuffle_ps(rx, ry, _MM_SHUFFLE(2, 2, 2, 2))));
+    _mm_storeu_ps(res + 8,
+      pairs(_mm_shuffle_ps(rz, rx, _MM_SHUFFLE(3, 3, 2, 2)),
+        _mm_shuffle_ps(ry, rz, _MM_SHUFFLE(3, 3, 3, 3))));
+  }
+#endif
+  rotate_vectors_scalar(m, v, res, count - i);
+}
+
+} // namespace ares::simd
+
+#endif //__ARES_SIMD_H__
@@ -0,0 +1,398 @@
+#ifndef __ARES_SPATIAL_HASH_H__
+#define __ARES_SPATIAL_HASH_H__
+
+#include "bbox3.h"
+#include "cull.h"
+#include "plane.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace ares
+{
+
+/**
+ * @brief Uniform grid over points hashed by their quantized position, for broad phase queries on
+ * many similar sized moving objects. The grid is rebuilt from scratch with a counting sort by hash
+ * bucket, so the objects of a bucket are contiguous and there is no per cell allocation, large
+ * rebuilds run in parallel. Use a cell size close to the query radius
+ */
+class Spatial_hash
+{
+public:
+
+  // object stored in bucket order
+  struct Entry
+  {
+    // object position
+    dvec3 pos;
+    // object index in the positions used to build
+    int32_t index{0};
+    // grid cell containing the position
+    ivec3 cell;
+  };
+
+  /**
+   * @brief C++ constructor
+   * @param cell_size Grid cell edge length, must be positive
+   */
+  explicit Spatial_hash(double cell_size);
+
+  /**
+   * @brief Rebuild the grid, the objects order inside a bucket is unspecified when the rebuild
+   * runs in parallel
+   * @param positions Object positions, cell coordinates must fit in 32 bits
+   */
+  void build(std::span<const dvec3> positions);
+
+  /**
+   * @brief Get the grid cell edge length
+   * @return Cell size
+   */
+  double cell_size() const;
+
+  /**
+   * @brief Get the number of objects
+   * @return Number of objects
+   */
+  int32_t size() const;
+
+  /**
+   * @brief Get the objects in bucket order
+   * @return Entries
+   */
+  std::span<const Entry> entries() const;
+
+  /**
+   * @brief Compute the grid cell containing a position
+   * @param pos Position to use
+   * @return Cell coordinates
+   */
+  ivec3 cell_of(const dvec3& pos) const;
+
+  /**
+   * @brief Visit the objects within a distance of a point
+   * @tparam F Visitor type
+   * @param center Point to use
+   * @param radius Max distance, visits the cells overlapping the sphere bounding box
+   * @param visit Called as visit(int32_t index) for each object within the distance
+   */
+  template <typename F>
+  void query(const dvec3& center, double radius, F&& visit) const;
+
+  /**
+   * @brief Visit the objects inside or crossing a convex volume, each object is a cube centered on
+   * its position, cells fully inside or outside the volume classify their objects together
+   * @tparam F Visitor type
+   * @param planes Planes with normals pointing inside the volume, e.g. frustum planes from
+   * Frustum::compute_planes, not required to be normalized
+   * @param radius Half edge length of the objects cubes
+   * @param visit Called as visit(int32_t index, Visibility vis) for each object not outside
+   */
+  template <typename F>
+  void cull(const std::array<Plane, 6>& planes, double radius, F&& visit) const;
+
+  /**
+   * @brief Visit each pair of objects within a distance of each other once
+   * @tparam F Visitor type
+   * @param radius Max distance
+   * @param visit Called as visit(int32_t index_a, int32_t index_b) for each pair
+   */
+  template <typename F>
+  void pairs(double radius, F&& visit) const;
+
+private:
+
+  /**
+   * @brief Compute the hash bucket of a grid cell
+   * @param cell Cell coordinates
+   * @return Bucket index
+   */
+  int32_t bucket_of(const ivec3& cell) const;
+
+  /**
+   * @brief Split a range in one chunk per hardware thread and process the chunks in parallel, or
+   * the whole range on this thread when it is small
+   * @tparam F Chunk function type
+   * @param count Range size
+   * @param process Called as process(int32_t begin, int32_t end, bool parallel) for each chunk
+   */
+  template <typename F>
+  static void for_chunks(int32_t count, F&& process);
+
+  /**
+   * @brief Increment a counter, atomically when it is shared by parallel chunks
+   * @param value Counter to increment
+   * @param parallel Counter is shared by parallel chunks
+   * @return Counter value before the increment
+   */
+  static int32_t fetch_add(int32_t& value, bool parallel);
+
+  // rebuilds with fewer objects run on the calling thread
+  static constexpr int32_t min_parallel = 1 << 16;
+
+  // grid cell edge length
+  double _cell_size{1};
+  // inverse of the grid cell edge length
+  double _inv_cell_size{1};
+  // objects sorted by bucket
+  std::vector<Entry> _entries;
+  // first entry of each bucket, followed by the entries count
+  std::vector<int32_t> _starts;
+  // next entry of each bucket while scattering the objects
+  std::vector<int32_t> _cursors;
+  // bucket of each object while scattering the objects
+  std::vector<int32_t> _buckets;
+  // number of buckets minus 1, the number of buckets is a power of 2
+  uint32_t _bucket_mask{0};
+};
+
+
+
+inline Spatial_hash::Spatial_hash(double cell_size)
+  : _cell_size{cell_size}, _inv_cell_size{1 / cell_size}
+{
+}
+
+
+
+inline void Spatial_hash::build(std::span<const dvec3> positions)
+{
+  const auto count = static_cast<int32_t>(positions.size());
+  const auto buckets = std::bit_ceil(2 * static_cast<uint32_t>(std::max(count, 1)));
+  _bucket_mask = buckets - 1;
+  _starts.assign(buckets + 1, 0);
+  _buckets.resize(count);
+  _entries.resize(count);
+
+  // count the objects of each bucket, the counts are shifted by 1 to become starts in place
+  for_chunks(
+    count,
+    [&](int32_t begin, int32_t end, bool parallel)
+    {
+      for (int32_t i = begin; i < end; ++i)
+      {
+        const auto bucket = bucket_of(cell_of(positions[i]));
+        _buckets[i] = bucket;
+        fetch_add(_starts[bucket + 1], parallel);
+      }
+    });
+  for (uint32_t i = 1; i <= buckets; ++i)
+  {
+    _starts[i] += _starts[i - 1];
+  }
+
+  // scatter the objects to their bucket range
+  _cursors.assign(_starts.begin(), _starts.end() - 1);
+  for_chunks(
+    count,
+    [&](int32_t begin, int32_t end, bool parallel)
+    {
+      for (int32_t i = begin; i < end; ++i)
+      {
+        const auto slot = fetch_add(_cursors[_buckets[i]], parallel);
+        _entries[slot] = {.pos = positions[i], .index = i, .cell = cell_of(positions[i])};
+      }
+    });
+}
+
+
+
+inline double Spatial_hash::cell_size() const
+{
+  return _cell_size;
+}
+
+
+
+inline int32_t Spatial_hash::size() const
+{
+  return static_cast<int32_t>(_entries.size());
+}
+
+
+
+inline std::span<const Spatial_hash::Entry> Spatial_hash::entries() const
+{
+  return _entries;
+}
+
+
+
+inline ivec3 Spatial_hash::cell_of(const dvec3& pos) const
+{
+  return {
+    .x = static_cast<int32_t>(std::floor(pos.x * _inv_cell_size)),
+    .y = static_cast<int32_t>(std::floor(pos.y * _inv_cell_size)),
+    .z = static_cast<int32_t>(std::floor(pos.z * _inv_cell_size))};
+}
+
+
+
+template <typename F>
+void Spatial_hash::query(const dvec3& center, double radius, F&& visit) const
+{
+  if (_entries.empty())
+  {
+    return;
+  }
+
+  // colliding cells share a bucket, the cell check keeps only the objects of the visited cell
+  const dvec3 extent{.x = radius, .y = radius, .z = radius};
+  const auto first = cell_of(center - extent);
+  const auto last = cell_of(center + extent);
+  const double radius2 = radius * radius;
+  for (int32_t z = first.z; z <= last.z; ++z)
+  {
+    for (int32_t y = first.y; y <= last.y; ++y)
+    {
+      for (int32_t x = first.x; x <= last.x; ++x)
+      {
+        const ivec3 cell{.x = x, .y = y, .z = z};
+        const auto bucket = bucket_of(cell);
+        for (int32_t i = _starts[bucket]; i < _starts[bucket + 1]; ++i)
+        {
+          const auto& entry = _entries[i];
+          if (entry.cell == cell && (entry.pos - center).dot(entry.pos - center) <= radius2)
+          {
+            visit(entry.index);
+          }
+        }
+      }
+    }
+  }
+}
+
+
+
+template <typename F>
+void Spatial_hash::cull(const std::array<Plane, 6>& planes, double radius, F&& visit) const
+{
+  // entries of a cell are consecutive unless the bucket is shared, then the cell is classified
+  // once per run
+  const dvec3 extent{.x = radius, .y = radius, .z = radius};
+  const auto size = static_cast<int32_t>(_entries.size());
+  for (int32_t i = 0; i < size;)
+  {
+    const auto cell = _entries[i].cell;
+    const dvec3 cell_min{
+      .x = cell.x * _cell_size, .y = cell.y * _cell_size, .z = cell.z * _cell_size};
+    const dvec3 cell_size{.x = _cell_size, .y = _cell_size, .z = _cell_size};
+    const Bbox3 cell_box{.min = cell_min - extent, .max = cell_min + cell_size + extent};
+    const auto mask = classify(cell_box, planes, 0x3f);
+    for (; i < size && _entries[i].cell == cell; ++i)
+    {
+      if (mask < 0)
+      {
+        continue;
+      }
+
+      const auto& entry = _entries[i];
+      const Bbox3 box{.min = entry.pos - extent, .max = entry.pos + extent};
+      const auto entry_mask = 0 == mask ? 0 : classify(box, planes, mask);
+      if (entry_mask >= 0)
+      {
+        visit(entry.index, 0 == entry_mask ? Visibility::Inside : Visibility::Intersects);
+      }
+    }
+  }
+}
+
+
+
+template <typename F>
+void Spatial_hash::pairs(double radius, F&& visit) const
+{
+  // each pair is reported by its entry that comes first in bucket order
+  const dvec3 extent{.x = radius, .y = radius, .z = radius};
+  const double radius2 = radius * radius;
+  const auto size = static_cast<int32_t>(_entries.size());
+  for (int32_t a = 0; a < size; ++a)
+  {
+    const auto& entry_a = _entries[a];
+    const auto first = cell_of(entry_a.pos - extent);
+    const auto last = cell_of(entry_a.pos + extent);
+    for (int32_t z = first.z; z <= last.z; ++z)
+    {
+      for (int32_t y = first.y; y <= last.y; ++y)
+      {
+        for (int32_t x = first.x; x <= last.x; ++x)
+        {
+          const ivec3 cell{.x = x, .y = y, .z = z};
+          const auto bucket = bucket_of(cell);
+          for (int32_t b = std::max(_starts[bucket], a + 1); b < _starts[bucket + 1]; ++b)
+          {
+            const auto& entry_b = _entries[b];
+            const dvec3 diff = entry_b.pos - entry_a.pos;
+            if (entry_b.cell == cell && diff.dot(diff) <= radius2)
+            {
+              visit(entry_a.index, entry_b.index);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+
+
+inline int32_t Spatial_hash::bucket_of(const ivec3& cell) const
+{
+  const auto hash = (static_cast<uint32_t>(cell.x) * 73856093u)
+                    ^ (static_cast<uint32_t>(cell.y) * 19349663u)
+                    ^ (static_cast<uint32_t>(cell.z) * 83492791u);
+  return static_cast<int32_t>(hash & _bucket_mask);
+}
+
+
+
+template <typename F>
+void Spatial_hash::for_chunks(int32_t count, F&& process)
+{
+  const auto threads = static_cast<int32_t>(std::max(std::thread::hardware_concurrency(), 1u));
+  if (count < min_parallel || 1 == threads)
+  {
+    process(0, count, false);
+    return;
+  }
+
+  const int32_t chunk = (count + threads - 1) / threads;
+  std::vector<std::future<void>> tasks;
+  tasks.reserve(threads - 1);
+  for (int32_t begin = chunk; begin < count; begin += chunk)
+  {
+    const auto end = std::min(begin + chunk, count);
+    tasks.push_back(
+      std::async(std::launch::async, [&process, begin, end] { process(begin, end, true); }));
+  }
+  process(0, std::min(chunk, count), true);
+  for (auto& task : tasks)
+  {
+    task.get();
+  }
+}
+
+
+
+inline int32_t Spatial_hash::fetch_add(int32_t& value, bool parallel)
+{
+  if (parallel)
+  {
+    return std::atomic_ref<int32_t>(value).fetch_add(1, std::memory_order_relaxed);
+  }
+  return value++;
+}
+
+} // namespace ares
+
+#endif //__ARES_SPATIAL_HASH_H__
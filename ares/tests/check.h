@@ -0,0 +1,25 @@
+#ifndef __ARES_TESTS_CHECK_H__
+#define __ARES_TESTS_CHECK_H__
+
+#include <cstdio>
+
+namespace ares::tests
+{
+
+/**
+ * @brief Report a measured value against its bound
+ * @param name Name of the measured value
+ * @param value Measured value, e.g. a max error
+ * @param bound Largest accepted value
+ * @return True if the value is within bound
+ */
+inline bool check(const char* name, double value, double bound)
+{
+  const bool passed = value <= bound;
+  std::printf("%-40s %10.3g <= %10.3g %s\n", name, value, bound, passed ? "ok" : "FAILED");
+  return passed;
+}
+
+} // namespace ares::tests
+
+#endif //__ARES_TESTS_CHECK_H__
@@ -0,0 +1,199 @@
+#include "check.h"
+
+#include <ares/cull.h>
+#include <ares/quat.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+// documented distance to a plane, relative to the scene scale, within which float and double
+// culls may disagree, see ares/cull.h
+constexpr double plane_epsilon = 1e-6;
+
+/**
+ * @brief Convert a vector to another floating point type
+ * @tparam T Floating point type to convert to
+ * @tparam U Floating point type to convert from
+ * @param v Vector to convert
+ * @return Converted vector
+ */
+template <std::floating_point T, std::floating_point U>
+ares::Vec3<T> convert(const ares::Vec3<U>& v)
+{
+  return {.x = static_cast<T>(v.x), .y = static_cast<T>(v.y), .z = static_cast<T>(v.z)};
+}
+
+
+
+/**
+ * @brief Convert planes to another floating point type
+ * @tparam T Floating point type to convert to
+ * @tparam U Floating point type to convert from
+ * @param planes Planes to convert
+ * @return Converted planes
+ */
+template <std::floating_point T, std::floating_point U>
+std::array<ares::Plane_t<T>, 6> convert(const std::array<ares::Plane_t<U>, 6>& planes)
+{
+  auto res = std::array<ares::Plane_t<T>, 6>{
+    ares::Plane_t<T>{{}, convert<T>(planes[0].normal)},
+    {{}, convert<T>(planes[1].normal)},
+    {{}, convert<T>(planes[2].normal)},
+    {{}, convert<T>(planes[3].normal)},
+    {{}, convert<T>(planes[4].normal)},
+    {{}, convert<T>(planes[5].normal)}};
+  for (size_t i = 0; i < res.size(); ++i)
+  {
+    res[i].d = static_cast<T>(planes[i].d);
+  }
+  return res;
+}
+
+
+
+/**
+ * @brief Convert a classify result to a visibility
+ * @param crossing Mask of the crossed planes, -1 if outside
+ * @return Visibility
+ */
+ares::Visibility to_visibility(int32_t crossing)
+{
+  return crossing < 0  ? ares::Visibility::Outside
+       : 0 == crossing ? ares::Visibility::Inside
+                       : ares::Visibility::Intersects;
+}
+
+
+
+/**
+ * @brief Compute the distance of the n or p vertex of a box closest to its plane, relative to the
+ * scene scale, the magnitude of the box coordinates and of the plane distance to the origin
+ * @param box Bounding box
+ * @param planes Planes
+ * @return Relative distance
+ */
+double relative_plane_distance(const ares::Bbox3& box, const std::array<ares::Plane, 6>& planes)
+{
+  const ares::dvec3 center = box.center();
+  const ares::dvec3 ext = (box.max - box.min) / 2;
+  double closest = std::numeric_limits<double>::max();
+  for (const auto& plane : planes)
+  {
+    const auto& normal = plane.normal;
+    const double len = normal.length();
+    const double dist = (normal.dot(center) + plane.d) / len;
+    const double radius =
+      (std::abs(normal.x) * ext.x + std::abs(normal.y) * ext.y + std::abs(normal.z) * ext.z) / len;
+    const double scale = std::max({box.min.length(), box.max.length(), std::abs(plane.d) / len});
+    closest = std::min({closest, std::abs(dist - radius) / scale, std::abs(dist + radius) / scale});
+  }
+  return closest;
+}
+
+
+
+/**
+ * @brief Make random views and random boxes, half of them with a corner close to a view plane,
+ * and compare the float and double culls of the same boxes and planes
+ * @param max_distance Set to the max relative plane distance of the disagreeing boxes
+ * @return Number of disagreements
+ */
+int32_t compare_culls(double& max_distance)
+{
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> unit(-1, 1);
+  std::uniform_real_distribution<double> size(0.01, 100);
+  std::uniform_real_distribution<double> offset(-1e-6, 1e-6);
+  std::uniform_int_distribution<int32_t> plane_index(0, 5);
+  const auto random_vec = [&rng, &unit](double scale)
+  {
+    return ares::dvec3{.x = unit(rng), .y = unit(rng), .z = unit(rng)} * scale;
+  };
+
+  constexpr int32_t views = 100;
+  constexpr int32_t boxes_per_view = 20000;
+  int32_t disagreements = 0;
+  std::vector<ares::Bbox3f> boxes_f(boxes_per_view);
+  std::vector<ares::Bbox3> boxes_d(boxes_per_view);
+  std::vector<ares::Visibility> result_f(boxes_per_view);
+  std::vector<ares::Visibility> result_d(boxes_per_view);
+  for (int32_t view = 0; view < views; ++view)
+  {
+    auto ax = random_vec(1);
+    ax.normalize();
+    const auto rotation = ares::dquat::make_from(ax, unit(rng) * 3);
+    const double far = 100 + 2000 * std::abs(unit(rng));
+    const auto frustum = ares::Frustum::make(
+      ares::dcs3::make(random_vec(500), rotation),
+      1 + unit(rng) / 2,
+      1.5 + unit(rng) / 2,
+      0.5 + unit(rng) / 2,
+      far);
+
+    // the same planes and boxes in both types, only the arithmetic differs
+    const auto planes_f = convert<float>(frustum.compute_planes());
+    const auto planes_d = convert<double>(planes_f);
+    for (int32_t b = 0; b < boxes_per_view; ++b)
+    {
+      const ares::dvec3 center = frustum.cs.origin + random_vec(far);
+      const ares::dvec3 ext{.x = size(rng), .y = size(rng), .z = size(rng)};
+      ares::Bbox3 box{.min = center - ext, .max = center + ext};
+      if (1 == b % 2)
+      {
+        // move the box along the plane normal until its n or p vertex is about on the plane
+        const auto& plane = planes_d[plane_index(rng)];
+        const auto& normal = plane.normal;
+        const double radius =
+          std::abs(normal.x) * ext.x + std::abs(normal.y) * ext.y + std::abs(normal.z) * ext.z;
+        const double vertex = unit(rng) < 0 ? -radius : radius;
+        const double dist = normal.dot(center) + plane.d + vertex;
+        const ares::dvec3 shift = normal * ((offset(rng) * far - dist) / normal.dot(normal));
+        box.min += shift;
+        box.max += shift;
+      }
+      boxes_f[b] = {.min = convert<float>(box.min), .max = convert<float>(box.max)};
+      boxes_d[b] = {
+        .min = convert<double>(boxes_f[b].min), .max = convert<double>(boxes_f[b].max)};
+    }
+
+    ares::cull<float>(planes_f, boxes_f, result_f);
+    ares::cull<double>(planes_d, boxes_d, result_d);
+    for (int32_t b = 0; b < boxes_per_view; ++b)
+    {
+      const auto classified_f = to_visibility(ares::classify(boxes_f[b], planes_f, 0x3f));
+      const auto classified_d = to_visibility(ares::classify(boxes_d[b], planes_d, 0x3f));
+      if (result_f[b] != result_d[b] || classified_f != classified_d
+          || result_d[b] != classified_d)
+      {
+        ++disagreements;
+        max_distance = std::max(max_distance, relative_plane_distance(boxes_d[b], planes_d));
+      }
+    }
+  }
+  return disagreements;
+}
+
+} // namespace
+
+/**
+ * @brief Check that the float culls match the double culls, except for boxes about on a plane
+ * @return 0 if all disagreements are within the documented plane distance
+ */
+int main()
+{
+  double max_distance = 0;
+  const int32_t disagreements = compare_culls(max_distance);
+  std::printf("%d disagreements between float and double culls\n", disagreements);
+  const bool passed =
+    ares::tests::check("cull disagreement plane distance", max_distance, plane_epsilon);
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,295 @@
+#include "check.h"
+
+#include <ares/fast.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <random>
+
+namespace
+{
+
+// documented max errors, see ares/fast.h, derived from each method with margin over the measured
+// errors so that other compilers and FMA contraction pass
+#if defined(ARES_SIMD_AVX) || defined(ARES_SIMD_SSE2)
+constexpr double rsqrt_error = 5e-7;
+constexpr double normalize_error = 6e-7;
+#else
+constexpr double rsqrt_error = 6e-6;
+constexpr double normalize_error = 7e-6;
+#endif
+constexpr double sin_error_f = 3e-7;
+constexpr double sin_error_d = 5e-9;
+// added by the range reduction per radian past the documented range
+constexpr double sin_range = 1e4;
+constexpr double sin_error_per_rad = 3e-16;
+constexpr double rotate_error_f = 1e-6;
+constexpr double rotate_error_d = 1e-8;
+
+/**
+ * @brief Bound of the relative error of a result rounded several times, each time within half an
+ * ulp, e.g. by the multiplications of an integer power
+ * @tparam T Floating point type
+ * @param roundings Number of roundings
+ * @return Relative error bound
+ */
+template <std::floating_point T>
+constexpr double rounding_error(int32_t roundings)
+{
+  const double half_ulp = std::numeric_limits<T>::epsilon() / 2;
+  return roundings * half_ulp * (1 + roundings * half_ulp);
+}
+
+/**
+ * @brief Iterate positive floating point values by their bit patterns, which sweeps every binade
+ * with the same density, from subnormals to the largest values
+ * @tparam T Floating point type
+ * @param from First value
+ * @param to Last value
+ * @param count Approximate number of values
+ * @param func Function called with each value
+ */
+template <std::floating_point T, typename F>
+void sweep_bits(T from, T to, uint64_t count, F func)
+{
+  using Bits = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
+  const auto first = std::bit_cast<Bits>(from);
+  const auto last = std::bit_cast<Bits>(to);
+  const auto step = static_cast<Bits>(std::max<uint64_t>(1, (last - first) / count));
+  for (Bits bits = first; bits < last; bits += step)
+  {
+    func(std::bit_cast<T>(bits));
+  }
+  func(to);
+}
+
+
+
+/**
+ * @brief Iterate evenly spaced values of an interval
+ * @tparam T Floating point type
+ * @param from First value
+ * @param to Last value
+ * @param count Number of intervals
+ * @param func Function called with each value
+ */
+template <std::floating_point T, typename F>
+void sweep(double from, double to, int32_t count, F func)
+{
+  for (int32_t i = 0; i <= count; ++i)
+  {
+    func(static_cast<T>(from + (to - from) * i / count));
+  }
+}
+
+
+
+template <std::floating_point T>
+double rsqrt_error_of(T x)
+{
+  const long double exact = 1 / std::sqrt(static_cast<long double>(x));
+  return static_cast<double>(std::abs(ares::fast::rsqrt(x) - exact) / exact);
+}
+
+
+
+/**
+ * @brief Max relative error of rsqrt over all valid values
+ * @tparam T Floating point type
+ * @return Max error
+ */
+template <std::floating_point T>
+double max_rsqrt_error()
+{
+  double error = 0;
+  const auto measure = [&error](T x)
+  {
+    error = std::max(error, rsqrt_error_of(x));
+  };
+
+  // the estimate only depends on the mantissa and the exponent parity, [1, 4) holds every case
+  sweep_bits<T>(1, 4, 1 << 24, measure);
+  // floats must be normal, doubles can be anything
+  const T from = std::same_as<T, float> ? std::numeric_limits<T>::min()
+                                        : std::numeric_limits<T>::denorm_min();
+  sweep_bits<T>(from, std::numeric_limits<T>::max(), 1 << 24, measure);
+
+  // past the float range where the estimate cannot be made
+  for (const double x : {1e-300, 1e-40, 1e-38, 1e38, 1e39, 1e300})
+  {
+    if (x >= std::numeric_limits<T>::min() && x <= std::numeric_limits<T>::max())
+    {
+      measure(static_cast<T>(x));
+    }
+  }
+  return error;
+}
+
+
+
+/**
+ * @brief Max absolute error of sin and cos for angles in [-1e8, 1e8], less the documented error
+ * added by the range reduction past [-1e4, 1e4]
+ * @tparam T Floating point type
+ * @return Max error
+ */
+template <std::floating_point T>
+double max_sin_error()
+{
+  double error = 0;
+  const auto measure = [&error](T x)
+  {
+    const auto xd = static_cast<long double>(x);
+    const double reduction = sin_error_per_rad * std::max(0.0, static_cast<double>(x) - sin_range);
+    for (const T a : {x, -x})
+    {
+      const auto ad = a < 0 ? -xd : xd;
+      const auto sin_error = std::abs(ares::fast::sin(a) - std::sin(ad));
+      const auto cos_error = std::abs(ares::fast::cos(a) - std::cos(ad));
+      error = std::max(error, static_cast<double>(std::max(sin_error, cos_error)) - reduction);
+    }
+  };
+
+  sweep_bits<T>(0, 1e8, 1 << 22, measure);
+  sweep<T>(0, sin_range, 1 << 22, measure);
+  sweep<T>(sin_range, 1e8, 1 << 20, measure);
+  return error;
+}
+
+
+
+/**
+ * @brief Max relative error of an integer power whose result stays a normal value
+ * @tparam N Power
+ * @tparam T Floating point type
+ * @return Max error
+ */
+template <int N, std::floating_point T>
+double max_pow_error()
+{
+  // the largest base whose power is finite and the smallest whose power is normal
+  const T to = std::pow(std::numeric_limits<T>::max(), T{1} / N) / 2;
+  const T from = std::pow(std::numeric_limits<T>::min(), T{1} / N) * 2;
+  double error = 0;
+  sweep_bits<T>(
+    from,
+    to,
+    1 << 22,
+    [&error](T x)
+    {
+      const long double exact = std::pow(static_cast<long double>(x), N);
+      const long double approx = ares::fast::pow<N>(x);
+      error = std::max(error, static_cast<double>(std::abs(approx - exact) / exact));
+    });
+  return error;
+}
+
+
+
+/**
+ * @brief Max error of normalize against Vec3::normalize, for vectors of all lengths whose squared
+ * length is finite, the vectors too short to be normalized are left as they are by both
+ * @tparam T Floating point type
+ * @return Max error
+ */
+template <std::floating_point T>
+double max_normalize_error()
+{
+  const double max_exp = std::log10(std::numeric_limits<T>::max()) / 2 - 1;
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> coord(-1, 1);
+  std::uniform_real_distribution<double> exponent(-10, max_exp);
+  double error = 0;
+  for (int32_t i = 0; i < 1 << 21; ++i)
+  {
+    const double scale = std::pow(10.0, exponent(rng));
+    const ares::Vec3<T> v{
+      .x = static_cast<T>(coord(rng) * scale),
+      .y = static_cast<T>(coord(rng) * scale),
+      .z = static_cast<T>(coord(rng) * scale)};
+    const auto fast = ares::fast::make_normalized(v);
+    auto precise = v;
+    precise.normalize();
+    const double len = static_cast<double>(precise.length());
+    error = std::max(error, static_cast<double>((fast - precise).length()) / len);
+  }
+
+  // squared length far out of the float range
+  if constexpr (std::same_as<T, double>)
+  {
+    ares::dvec3 v{.x = 1e20};
+    ares::fast::normalize(v);
+    error = std::max(error, std::abs(v.x - 1) + std::abs(v.y) + std::abs(v.z));
+  }
+  return error;
+}
+
+
+
+/**
+ * @brief Max error of rotate relative to the vector length, for angles in [-10, 10]
+ * @tparam T Floating point type
+ * @return Max error
+ */
+template <std::floating_point T>
+double max_rotate_error()
+{
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> coord(-100, 100);
+  std::uniform_real_distribution<double> angle(-10, 10);
+  const auto random_vec = [&rng, &coord]
+  {
+    return ares::Vec3<T>{
+      .x = static_cast<T>(coord(rng)),
+      .y = static_cast<T>(coord(rng)),
+      .z = static_cast<T>(coord(rng))};
+  };
+  const auto to_long = [](const ares::Vec3<T>& v)
+  {
+    return ares::Vec3<long double>{.x = v.x, .y = v.y, .z = v.z};
+  };
+
+  double error = 0;
+  for (int32_t i = 0; i < 1 << 21; ++i)
+  {
+    auto v = random_vec();
+    auto ax = random_vec();
+    ax.normalize();
+    const auto rad = static_cast<T>(angle(rng));
+    auto exact = to_long(v);
+    exact.rotate(to_long(ax), static_cast<long double>(rad));
+    ares::fast::rotate(v, ax, rad);
+    error = std::max(error, static_cast<double>((to_long(v) - exact).length() / exact.length()));
+  }
+  return error;
+}
+
+} // namespace
+
+/**
+ * @brief Measure the max errors of the approximate math functions against the precise ones over
+ * their documented input ranges
+ * @return 0 if all errors are within their documented bounds
+ */
+int main()
+{
+  using ares::tests::check;
+  bool passed = true;
+  passed &= check("rsqrt float relative", max_rsqrt_error<float>(), rsqrt_error);
+  passed &= check("rsqrt double relative", max_rsqrt_error<double>(), rsqrt_error);
+  passed &= check("sin cos float absolute", max_sin_error<float>(), sin_error_f);
+  passed &= check("sin cos double absolute", max_sin_error<double>(), sin_error_d);
+  passed &= check("pow<2> float relative", max_pow_error<2, float>(), rounding_error<float>(1));
+  passed &= check("pow<2> double relative", max_pow_error<2, double>(), rounding_error<double>(1));
+  passed &= check("pow<3> float relative", max_pow_error<3, float>(), rounding_error<float>(2));
+  passed &= check("pow<3> double relative", max_pow_error<3, double>(), rounding_error<double>(2));
+  passed &= check("normalize float", max_normalize_error<float>(), normalize_error);
+  passed &= check("normalize double", max_normalize_error<double>(), normalize_error);
+  passed &= check("rotate float relative", max_rotate_error<float>(), rotate_error_f);
+  passed &= check("rotate double relative", max_rotate_error<double>(), rotate_error_d);
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,526 @@
+#ifndef __ARES_VEC3_SOA_H__
+#define __ARES_VEC3_SOA_H__
+
+#include "bbox3.h"
+#include "epsilon.h"
+#include "matrix.h"
+#include "simd.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace ares
+{
+
+template <std::floating_point T>
+struct Vec3_soa;
+
+using dvec3_soa = Vec3_soa<double>;
+using fvec3_soa = Vec3_soa<float>;
+
+/**
+ * @brief Vectors stored as structure of arrays, one aligned contiguous array per coordinate, so
+ * that bulk operations process several vectors per SIMD instruction. The bulk operations below
+ * work on the vectors [first, first + count), as std::span::subspan count defaults to all the
+ * vectors from first
+ * @tparam T Floating point type to use
+ */
+template <std::floating_point T>
+struct Vec3_soa
+{
+  // coordinate array type
+  using Array = std::vector<T, simd::Aligned_allocator<T>>;
+
+  /**
+   * @brief Get the number of vectors
+   * @return Number of vectors
+   */
+  size_t size() const;
+
+  /**
+   * @brief Check if there are no vectors
+   * @return Result of check
+   */
+  bool empty() const;
+
+  /**
+   * @brief Change the number of vectors, new vectors are zero
+   * @param count Number of vectors
+   */
+  void resize(size_t count);
+
+  /**
+   * @brief Remove all vectors
+   */
+  void clear();
+
+  /**
+   * @brief Add a vector at the end
+   * @param v Vector to add
+   */
+  void push_back(const Vec3<T>& v);
+
+  /**
+   * @brief Set the vector at the provided index
+   * @param index Vector index
+   * @param v Vector to use
+   */
+  void set(size_t index, const Vec3<T>& v);
+
+  /**
+   * @brief Get the vector at the provided index
+   * @param index Vector index
+   * @return Vector
+   */
+  Vec3<T> get(size_t index) const;
+
+  /**
+   * @brief Replace the vectors by the provided array of structs vectors
+   * @param vs Vectors to use
+   */
+  void assign(std::span<const Vec3<T>> vs);
+
+  /**
+   * @brief Copy the vectors to an array of structs
+   * @param vs Destination, same size as this
+   */
+  void copy_to(std::span<Vec3<T>> vs) const;
+
+  // x coordinates
+  Array x;
+  // y coordinates
+  Array y;
+  // z coordinates
+  Array z;
+};
+
+/**
+ * @brief Add a vector to vectors
+ * @tparam T Floating point type to use
+ * @param vs Vectors to add to
+ * @param v Vector to add
+ * @param res Resulting vectors, resized to the vs size, can be the same object as vs
+ * @param first First vector
+ * @param count Number of vectors
+ */
+template <std::floating_point T>
+void add(
+  const Vec3_soa<T>& vs,
+  const Vec3<T>& v,
+  Vec3_soa<T>& res,
+  size_t first = 0,
+  size_t count = std::dynamic_extent);
+
+/**
+ * @brief Scale vectors
+ * @tparam T Floating point type to use
+ * @param vs Vectors to scale
+ * @param factor Scale factor
+ * @param res Resulting vectors, resized to the vs size, can be the same object as vs
+ * @param first First vector
+ * @param count Number of vectors
+ */
+template <std::floating_point T>
+void scale(
+  const Vec3_soa<T>& vs,
+  T factor,
+  Vec3_soa<T>& res,
+  size_t first = 0,
+  size_t count = std::dynamic_extent);
+
+/**
+ * @brief Dot products of vectors with a direction, e.g. depths along a view direction
+ * @tparam T Floating point type to use
+ * @param vs Vectors to use
+ * @param dir Direction to use
+ * @param res Dot products, res[i] is for vector first + i, at least count values
+ * @param first First vector
+ * @param count Number of vectors
+ */
+template <std::floating_point T>
+void dot(
+  const Vec3_soa<T>& vs,
+  const Vec3<T>& dir,
+  std::span<T> res,
+  size_t first = 0,
+  size_t count = std::dynamic_extent);
+
+/**
+ * @brief Transform points by a matrix, see Matrix::transform_p
+ * @tparam T Floating point type to use
+ * @param vs Points to transform
+ * @param mx Matrix to use, affine
+ * @param res Transformed points, resized to the vs size, can be the same object as vs
+ * @param first First point
+ * @param count Number of points
+ */
+template <std::floating_point T>
+void transform(
+  const Vec3_soa<T>& vs,
+  const Matrix<T>& mx,
+  Vec3_soa<T>& res,
+  size_t first = 0,
+  size_t count = std::dynamic_extent);
+
+/**
+ * @brief Normalize vectors, zero length vectors are left as they are, see Vec3::normalize
+ * @tparam T Floating point type to use
+ * @param vs Vectors to normalize
+ * @param first First vector
+ * @param count Number of vectors
+ */
+template <std::floating_point T>
+void normalize(Vec3_soa<T>& vs, size_t first = 0, size_t count = std::dynamic_extent);
+
+/**
+ * @brief Compute the bounding box of points with min and max reductions
+ * @tparam T Floating point type to use
+ * @param vs Points to bound
+ * @param first First point
+ * @param count Number of points
+ * @return Bounding box, empty if there are no points
+ */
+template <std::floating_point T>
+Bbox3_t<T> bounds(const Vec3_soa<T>& vs, size_t first = 0, size_t count = std::dynamic_extent);
+
+
+
+template <std::floating_point T>
+size_t Vec3_soa<T>::size() const
+{
+  return x.size();
+}
+
+
+
+template <std::floating_point T>
+bool Vec3_soa<T>::empty() const
+{
+  return x.empty();
+}
+
+
+
+template <std::floating_point T>
+void Vec3_soa<T>::resize(size_t count)
+{
+  x.resize(count);
+  y.resize(count);
+  z.resize(count);
+}
+
+
+
+template <std::floating_point T>
+void Vec3_soa<T>::clear()
+{
+  resize(0);
+}
+
+
+
+template <std::floating_point T>
+void Vec3_soa<T>::push_back(const Vec3<T>& v)
+{
+  x.push_back(v.x);
+  y.push_back(v.y);
+  z.push_back(v.z);
+}
+
+
+
+template <std::floating_point T>
+void Vec3_soa<T>::set(size_t index, const Vec3<T>& v)
+{
+  x[index] = v.x;
+  y[index] = v.y;
+  z[index] = v.z;
+}
+
+
+
+template <std::floating_point T>
+Vec3<T> Vec3_soa<T>::get(size_t index) const
+{
+  return {.x = x[index], .y = y[index], .z = z[index]};
+}
+
+
+
+template <std::floating_point T>
+void Vec3_soa<T>::assign(std::span<const Vec3<T>> vs)
+{
+  // one loop per coordinate, each with a single output array, so that the compiler can vectorize
+  // them
+  resize(vs.size());
+  for (size_t i = 0; i < vs.size(); ++i)
+  {
+    x[i] = vs[i].x;
+  }
+  for (size_t i = 0; i < vs.size(); ++i)
+  {
+    y[i] = vs[i].y;
+  }
+  for (size_t i = 0; i < vs.size(); ++i)
+  {
+    z[i] = vs[i].z;
+  }
+}
+
+
+
+template <std::floating_point T>
+void Vec3_soa<T>::copy_to(std::span<Vec3<T>> vs) const
+{
+  assert(vs.size() == size());
+  for (size_t i = 0; i < vs.size(); ++i)
+  {
+    vs[i] = {.x = x[i], .y = y[i], .z = z[i]};
+  }
+}
+
+
+
+template <std::floating_point T>
+void add(const Vec3_soa<T>& vs, const Vec3<T>& v, Vec3_soa<T>& res, size_t first, size_t count)
+{
+  using P = simd::pack<T>;
+  res.resize(vs.size());
+  const size_t end = first + std::min(count, vs.size() - first);
+  // the arrays are read through local pointers, the SIMD stores may alias the vectors members
+  const T* in_x = vs.x.data();
+  const T* in_y = vs.y.data();
+  const T* in_z = vs.z.data();
+  T* out_x = res.x.data();
+  T* out_y = res.y.data();
+  T* out_z = res.z.data();
+  const P add_x = simd::broadcast(v.x);
+  const P add_y = simd::broadcast(v.y);
+  const P add_z = simd::broadcast(v.z);
+  size_t i = first;
+  for (; i + P::size <= end; i += P::size)
+  {
+    simd::store(out_x + i, simd::load(in_x + i) + add_x);
+    simd::store(out_y + i, simd::load(in_y + i) + add_y);
+    simd::store(out_z + i, simd::load(in_z + i) + add_z);
+  }
+  for (; i < end; ++i)
+  {
+    out_x[i] = in_x[i] + v.x;
+    out_y[i] = in_y[i] + v.y;
+    out_z[i] = in_z[i] + v.z;
+  }
+}
+
+
+
+template <std::floating_point T>
+void scale(const Vec3_soa<T>& vs, T factor, Vec3_soa<T>& res, size_t first, size_t count)
+{
+  using P = simd::pack<T>;
+  res.resize(vs.size());
+  const size_t end = first + std::min(count, vs.size() - first);
+  const T* in_x = vs.x.data();
+  const T* in_y = vs.y.data();
+  const T* in_z = vs.z.data();
+  T* out_x = res.x.data();
+  T* out_y = res.y.data();
+  T* out_z = res.z.data();
+  const P f = simd::broadcast(factor);
+  size_t i = first;
+  for (; i + P::size <= end; i += P::size)
+  {
+    simd::store(out_x + i, simd::load(in_x + i) * f);
+    simd::store(out_y + i, simd::load(in_y + i) * f);
+    simd::store(out_z + i, simd::load(in_z + i) * f);
+  }
+  for (; i < end; ++i)
+  {
+    out_x[i] = in_x[i] * factor;
+    out_y[i] = in_y[i] * factor;
+    out_z[i] = in_z[i] * factor;
+  }
+}
+
+
+
+template <std::floating_point T>
+void dot(const Vec3_soa<T>& vs, const Vec3<T>& dir, std::span<T> res, size_t first, size_t count)
+{
+  using P = simd::pack<T>;
+  const size_t end = first + std::min(count, vs.size() - first);
+  assert(res.size() >= end - first);
+  const T* in_x = vs.x.data();
+  const T* in_y = vs.y.data();
+  const T* in_z = vs.z.data();
+  T* out = res.data();
+  const P dir_x = simd::broadcast(dir.x);
+  const P dir_y = simd::broadcast(dir.y);
+  const P dir_z = simd::broadcast(dir.z);
+  size_t i = first;
+  for (; i + P::size <= end; i += P::size)
+  {
+    const P dot_xy = simd::mul_add(simd::load(in_y + i), dir_y, simd::load(in_x + i) * dir_x);
+    simd::store(out + (i - first), simd::mul_add(simd::load(in_z + i), dir_z, dot_xy));
+  }
+  for (; i < end; ++i)
+  {
+    out[i - first] = in_x[i] * dir.x + in_y[i] * dir.y + in_z[i] * dir.z;
+  }
+}
+
+
+
+template <std::floating_point T>
+void transform(
+  const Vec3_soa<T>& vs, const Matrix<T>& mx, Vec3_soa<T>& res, size_t first, size_t count)
+{
+  using P = simd::pack<T>;
+  res.resize(vs.size());
+  const size_t end = first + std::min(count, vs.size() - first);
+  const T* in_x = vs.x.data();
+  const T* in_y = vs.y.data();
+  const T* in_z = vs.z.data();
+  T* out_x = res.x.data();
+  T* out_y = res.y.data();
+  T* out_z = res.z.data();
+  // the matrix is column major, mx_x[c] is the column c x value broadcast, and so on
+  P mx_x[4];
+  P mx_y[4];
+  P mx_z[4];
+  for (int c = 0; c < 4; ++c)
+  {
+    mx_x[c] = simd::broadcast(mx[4 * c]);
+    mx_y[c] = simd::broadcast(mx[4 * c + 1]);
+    mx_z[c] = simd::broadcast(mx[4 * c + 2]);
+  }
+  const auto row = [](const P (&m)[4], P px, P py, P pz)
+  {
+    return simd::mul_add(m[2], pz, simd::mul_add(m[1], py, simd::mul_add(m[0], px, m[3])));
+  };
+
+  size_t i = first;
+  for (; i + P::size <= end; i += P::size)
+  {
+    const P px = simd::load(in_x + i);
+    const P py = simd::load(in_y + i);
+    const P pz = simd::load(in_z + i);
+    simd::store(out_x + i, row(mx_x, px, py, pz));
+    simd::store(out_y + i, row(mx_y, px, py, pz));
+    simd::store(out_z + i, row(mx_z, px, py, pz));
+  }
+  for (; i < end; ++i)
+  {
+    res.set(i, mx.transform_p(vs.get(i)));
+  }
+}
+
+
+
+template <std::floating_point T>
+void normalize(Vec3_soa<T>& vs, size_t first, size_t count)
+{
+  using P = simd::pack<T>;
+  const size_t end = first + std::min(count, vs.size() - first);
+  T* xs = vs.x.data();
+  T* ys = vs.y.data();
+  T* zs = vs.z.data();
+  const P eps = simd::broadcast(static_cast<T>(deps));
+  const P one = simd::broadcast(T{1});
+  const auto normalize_one = [&vs](size_t index)
+  {
+    auto v = vs.get(index);
+    v.normalize();
+    vs.set(index, v);
+  };
+
+  size_t i = first;
+  for (; i + P::size <= end; i += P::size)
+  {
+    const P px = simd::load(xs + i);
+    const P py = simd::load(ys + i);
+    const P pz = simd::load(zs + i);
+    const P len = simd::sqrt(simd::mul_add(pz, pz, simd::mul_add(py, py, px * px)));
+    // packs with zero length vectors, rare, are left to the scalar code
+    if (0 != simd::less(len, eps))
+    {
+      for (size_t j = i; j < i + P::size; ++j)
+      {
+        normalize_one(j);
+      }
+      continue;
+    }
+
+    const P inv_len = one / len;
+    simd::store(xs + i, px * inv_len);
+    simd::store(ys + i, py * inv_len);
+    simd::store(zs + i, pz * inv_len);
+  }
+  for (; i < end; ++i)
+  {
+    normalize_one(i);
+  }
+}
+
+
+
+template <std::floating_point T>
+Bbox3_t<T> bounds(const Vec3_soa<T>& vs, size_t first, size_t count)
+{
+  using P = simd::pack<T>;
+  const size_t end = first + std::min(count, vs.size() - first);
+  const T* xs = vs.x.data();
+  const T* ys = vs.y.data();
+  const T* zs = vs.z.data();
+  Bbox3_t<T> box;
+  size_t i = first;
+  if (i + P::size <= end)
+  {
+    // per lane min and max corners, reduced to the box at the end
+    P min_x = simd::load(xs + i);
+    P min_y = simd::load(ys + i);
+    P min_z = simd::load(zs + i);
+    P max_x = min_x;
+    P max_y = min_y;
+    P max_z = min_z;
+    for (i += P::size; i + P::size <= end; i += P::size)
+    {
+      const P px = simd::load(xs + i);
+      const P py = simd::load(ys + i);
+      const P pz = simd::load(zs + i);
+      min_x = simd::min(min_x, px);
+      min_y = simd::min(min_y, py);
+      min_z = simd::min(min_z, pz);
+      max_x = simd::max(max_x, px);
+      max_y = simd::max(max_y, py);
+      max_z = simd::max(max_z, pz);
+    }
+
+    T lanes[6][P::size];
+    simd::store(lanes[0], min_x);
+    simd::store(lanes[1], min_y);
+    simd::store(lanes[2], min_z);
+    simd::store(lanes[3], max_x);
+    simd::store(lanes[4], max_y);
+    simd::store(lanes[5], max_z);
+    for (int l = 0; l < P::size; ++l)
+    {
+      box.extend({.x = lanes[0][l], .y = lanes[1][l], .z = lanes[2][l]});
+      box.extend({.x = lanes[3][l], .y = lanes[4][l], .z = lanes[5][l]});
+    }
+  }
+  for (; i < end; ++i)
+  {
+    box.extend({.x = xs[i], .y = ys[i], .z = zs[i]});
+  }
+  return box;
+}
+
+} // namespace ares
+
+#endif //__ARES_VEC3_SOA_H__
@@ -0,0 +1,34 @@
+#ifndef __HERA_BUFFERS_H__
+#define __HERA_BUFFERS_H__
+
+#include <cstdint>
+
+namespace hera
+{
+
+struct Buffers
+{
+  // vertex array object id
+  int32_t vao{0};
+  // vertex buffer object id
+  int32_t vbo{0};
+  // index buffer object id
+  int32_t ibo{0};
+  // per instance attributes buffer object id, only used by instanced parts
+  int32_t inst{0};
+  // revision of the uploaded data, re-uploaded when it differs from the parts revision
+  int32_t revision{-1};
+  // uploaded index size in bytes, 2 when the welded vertices fit 16 bit indices, otherwise 4
+  int32_t index_size{4};
+  // number of uploaded vertices, identical face vertices are welded into one
+  int32_t vertex_count{0};
+  // average vertex cache misses per triangle of the parts indices
+  float acmr_before{0};
+  // average vertex cache misses per triangle of the uploaded indices, solid and instanced parts
+  // triangles are reordered for the vertex cache, glass faces keep their order
+  float acmr_after{0};
+};
+
+} // namespace hera
+
+#endif //__HERA_BUFFERS_H__
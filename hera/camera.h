@@ -2,78 +2,98 @@
 #define __HERA_CAMERA_H__
 
 #include <ares/frustum.h>
+#include <ares/quat.h>
 #include <ares/vec2.h>
+#include <concepts>
 
 namespace hera
 {
 
-struct Camera
+template <std::floating_point T>
+struct Camera_t;
+
+using Camera = Camera_t<double>;
+using Cameraf = Camera_t<float>;
+
+/**
+ * @brief Perspective camera, a view frustum moved and rotated in its own cs
+ * @tparam T Floating point type to use
+ */
+template <std::floating_point T>
+struct Camera_t
 {
   /**
    * @brief Get camera coordinate system
    * @return Coordinate system
    */
-  ares::dcs3& cs();
+  ares::Cs3<T>& cs();
 
   /**
    * @brief Get camera coordinate system
    * @return Coordinate system
    */
-  const ares::dcs3& cs() const;
+  const ares::Cs3<T>& cs() const;
 
   /**
    * @brief Get camera position
    * @return Position
    */
-  ares::dvec3& position();
+  ares::Vec3<T>& position();
 
   /**
    * @brief Get camera position
    * @return Position
    */
-  const ares::dvec3& position() const;
+  const ares::Vec3<T>& position() const;
 
   /**
    * @brief Move the camera by the provide vector
    * @param vec Vector to move by
    */
-  void translate(const ares::dvec3& vec);
+  void translate(const ares::Vec3<T>& vec);
 
   /**
    * @brief Move the camera along the x axis by the provided step
    * @param step Step by which to move
    */
-  void advance(double step);
+  void advance(T step);
 
   /**
    * @brief Move the camera along the y axis by the provided step
    * @param step Step by which to move
    */
-  void ascend(double step);
+  void ascend(T step);
 
   /**
    * @brief Move the camera along the z axis by the provided step
    * @param step Step by which to move
    */
-  void strafe(double step);
+  void strafe(T step);
 
   /**
    * @brief Rotate the camera around the y axis by the provided angle in radians
    * @param angle Angle by which to rotate
    */
-  void yaw(double angle);
+  void yaw(T angle);
 
   /**
    * @brief Rotate the camera around the z axis by the provided angle in radians
    * @param angle Angle by which to rotate
    */
-  void pitch(double angle);
+  void pitch(T angle);
 
   /**
    * @brief Rotate the camera around the x axis by the provided angle in radians
    * @param angle Angle by which to rotate
    */
-  void roll(double angle);
+  void roll(T angle);
+
+  /**
+   * @brief Rotate the camera by a rotation expressed in its own cs, composed into the orientation
+   * from which the frustum axes are rebuilt
+   * @param rotation Rotation to apply, must be normalized
+   */
+  void rotate(const ares::Quat<T>& rotation);
 
   /**
    * @brief Set window center from window size
@@ -89,100 +109,125 @@ struct Camera
    * @param near_dist Near distance
    * @param far_dist Far distance
    */
-  void set_perspective(double fov, double aspect, double near_dist, double far_dist);
+  void set_perspective(T fov, T aspect, T near_dist, T far_dist);
 
   /**
    * @brief Rotate the camera to point at the specified 3D position
    * @param pos Position to point at
    */
-  void point_at(const ares::dvec3& pos);
+  void point_at(const ares::Vec3<T>& pos);
 
   // Camera frustum
-  ares::Frustum frustum{.cs = ares::dcs3::make({}, {.z = -1}, {.y = 1})};
+  ares::Frustum_t<T> frustum{.cs = ares::Cs3<T>::make({}, {.z = -1}, {.y = 1})};
+  // Rotation of the frustum axes, kept by the rotations so they need not recover it from the axes,
+  // set it to frustum.cs.rotation() after changing the axes directly
+  ares::Quat<T> orientation = frustum.cs.rotation();
   // Window center position, used to point the camera in the right direction
   ares::ivec2 center;
 };
 
 
 
-inline ares::dcs3& Camera::cs()
+template <std::floating_point T>
+ares::Cs3<T>& Camera_t<T>::cs()
 {
   return frustum.cs;
 }
 
 
 
-inline const ares::dcs3& Camera::cs() const
+template <std::floating_point T>
+const ares::Cs3<T>& Camera_t<T>::cs() const
 {
   return frustum.cs;
 }
 
 
 
-inline ares::dvec3& Camera::position()
+template <std::floating_point T>
+ares::Vec3<T>& Camera_t<T>::position()
 {
   return frustum.cs.origin;
 }
 
 
 
-inline const ares::dvec3& Camera::position() const
+template <std::floating_point T>
+const ares::Vec3<T>& Camera_t<T>::position() const
 {
   return frustum.cs.origin;
 }
 
 
 
-inline void Camera::translate(const ares::dvec3& vec)
+template <std::floating_point T>
+void Camera_t<T>::translate(const ares::Vec3<T>& vec)
 {
   frustum.cs.origin += vec;
 }
 
 
 
-inline void Camera::advance(double step)
+template <std::floating_point T>
+void Camera_t<T>::advance(T step)
 {
   frustum.cs.origin += frustum.cs.x_axis * step;
 }
 
 
 
-inline void Camera::ascend(double step)
+template <std::floating_point T>
+void Camera_t<T>::ascend(T step)
 {
   frustum.cs.origin += frustum.cs.y_axis * step;
 }
 
 
 
-inline void Camera::strafe(double step)
+template <std::floating_point T>
+void Camera_t<T>::strafe(T step)
 {
   frustum.cs.origin += frustum.cs.z_axis * step;
 }
 
 
 
-inline void Camera::yaw(double angle)
+template <std::floating_point T>
+void Camera_t<T>::yaw(T angle)
+{
+  rotate(ares::Quat<T>::make_from({.y = 1}, angle));
+}
+
+
+
+template <std::floating_point T>
+void Camera_t<T>::pitch(T angle)
 {
-  frustum.cs.rotate_by_y(angle);
+  rotate(ares::Quat<T>::make_from({.z = 1}, angle));
 }
 
 
 
-inline void Camera::pitch(double angle)
+template <std::floating_point T>
+void Camera_t<T>::roll(T angle)
 {
-  frustum.cs.rotate_by_z(angle);
+  rotate(ares::Quat<T>::make_from({.x = 1}, angle));
 }
 
 
 
-inline void Camera::roll(double angle)
+template <std::floating_point T>
+void Camera_t<T>::rotate(const ares::Quat<T>& rotation)
 {
-  frustum.cs.rotate_by_x(angle);
+  orientation *= rotation;
+  orientation.normalize();
+  orientation.to_axes(frustum.cs.x_axis, frustum.cs.y_axis, frustum.cs.z_axis);
 }
 
 
 
-inline void Camera::set_window_center(int x, int y)
+template <std::floating_point T>
+void Camera_t<T>::set_window_center(int x, int y)
 {
   center.x = x;
   center.y = y;
@@ -190,16 +235,19 @@ inline void Camera::set_window_center(int x, int y)
 
 
 
-inline void Camera::set_perspective(double fov, double aspect, double near_dist, double far_dist)
+template <std::floating_point T>
+void Camera_t<T>::set_perspective(T fov, T aspect, T near_dist, T far_dist)
 {
   frustum.set_perspective(fov, aspect, near_dist, far_dist);
 }
 
 
 
-inline void Camera::point_at(const ares::dvec3& pos)
+template <std::floating_point T>
+void Camera_t<T>::point_at(const ares::Vec3<T>& pos)
 {
   frustum.cs.set_x_axis((pos - frustum.cs.origin).make_normalized());
+  orientation = frustum.cs.rotation();
 }
 
 } // namespace hera
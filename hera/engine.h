@@ -49,7 +49,7 @@ public:
   void point_camera(Camera& cam, int32_t winx, int32_t winy);
 
   /**
-   * @brief Set camera in scene
+   * @brief Set camera in scene, also sets the renderer view frustum used for culling
    * @param cam Camera to set
    */
   void set_camera(const Camera& cam);
@@ -135,6 +135,7 @@ inline void Engine::point_camera(Camera& cam, int32_t winx, int32_t winy)
 inline void Engine::set_camera(const Camera& cam)
 {
   renderer.look_at(cam.position(), cam.position() + cam.cs().x_axis, cam.cs().y_axis);
+  renderer.set_frustum(cam.frustum);
 }
 
 } // namespace hera
@@ -2,10 +2,17 @@
 #define __HERA_GLASSY_PARTS_H__
 
 #include "blend.h"
+#include "buffers.h"
+#include "part_bounds.h"
 #include "texture.h"
 #include "vertex.h"
 
+#include <ares/bbox3.h>
+#include <ares/cull.h>
+#include <ares/frustum.h>
 #include <ares/matrix.h>
+#include <ares/radix_sort.h>
+#include <ares/vec3_soa.h>
 #include <span>
 #include <vector>
 
@@ -13,7 +20,8 @@ namespace hera
 {
 
 /**
- * @brief Glass (transparent) 3D object parts collection (use sort before rendering)
+ * @brief Glass (transparent) 3D object parts collection (use sort before rendering, unless the
+ * renderer uses weighted blended transparency)
  */
 class Glass_parts
 {
@@ -25,8 +33,40 @@ public:
     Texture tex;
     // blend params
     Blend blend;
-    // matrix from object local cs
+    // matrix from object local cs, use set_matrix or set_origin to change it
     ares::dmatrix mat;
+    // first face index, part faces are contiguous
+    int32_t fbegin{0};
+    // number of faces
+    int32_t fcount{0};
+    // first index, part indices are contiguous
+    int32_t ibegin{0};
+    // number of indices
+    int32_t icount{0};
+    // part is convex, its faces are not sorted, back faces are rendered before front faces
+    bool convex{false};
+    // center in local cs, mean of the faces mid points
+    ares::dvec3 center;
+    // bounding box in local cs
+    ares::Bbox3 bbox;
+  };
+
+  // render order item, a single face or all faces of a convex part
+  struct Item
+  {
+    // part index
+    int32_t part{0};
+    // face index, -1 for all faces of a convex part
+    int32_t face{-1};
+    // depth key of the last sort, ascending keys are farthest to closest
+    uint32_t key{0};
+  };
+
+  // depth sort algorithm
+  enum class Sort
+  {
+    Radix,   // radix sort of the depth keys
+    Coherent // insertion sort starting from the last order, radix sort if too much changed
   };
 
   struct Face
@@ -39,8 +79,8 @@ public:
     bool is_quad{false};
     // vertex begin index
     int32_t vbegin{0};
-    // mid (center) point in world cs
-    ares::dvec3 wcs_mid;
+    // index begin index, faces are triangulated, 3 indices for triangles and 6 for quads
+    int32_t ibegin{0};
   };
 
   /**
@@ -48,8 +88,10 @@ public:
    * @param tex Part texture
    * @param blend Blend parameters
    * @param cs Local cs
+   * @param convex Part is a closed convex shape with faces counter clockwise seen from outside, it
+   * is sorted as a whole by its center instead of by faces
    */
-  void add_part(Texture tex, Blend blend, const ares::dcs3& cs);
+  void add_part(Texture tex, Blend blend, const ares::dcs3& cs, bool convex = false);
 
   /**
    * @brief Add a face for the last added part
@@ -76,16 +118,100 @@ public:
     const Vertex& v3);
 
   /**
-   * @brief Sort render order by depth along the provided vector direction, farthest to closest
+   * @brief Set the matrix of a part, its faces mid points are updated on the next sort and its
+   * world cs bounding box on the next request
+   * @param part Part index
+   * @param mat Matrix from object local cs
+   */
+  void set_matrix(int32_t part, const ares::dmatrix& mat);
+
+  /**
+   * @brief Set the matrix origin of a part, its faces mid points are updated on the next sort and
+   * its world cs bounding box on the next request
+   * @param part Part index
+   * @param origin Origin in world cs
+   */
+  void set_origin(int32_t part, const ares::dvec3& origin);
+
+  /**
+   * @brief Get all parts
+   * @return Parts
+   */
+  std::span<const Part> parts() const;
+
+  /**
+   * @brief Get the world cs bounding boxes of all parts, the boxes of parts that changed since the
+   * last request are updated first
+   * @return Bounding boxes, one per part
+   */
+  const ares::Bbox3_soa& world_boxes();
+
+  /**
+   * @brief Classify the world cs bounding boxes of all parts against a view frustum, starting with
+   * the plane that rejected each part on the previous call
+   * @param frustum View frustum
+   * @param result Visibility of each part, one per part
+   * @return Number of frustum plane tests
+   */
+  int32_t cull(const ares::Frustum& frustum, std::span<ares::Visibility> result);
+
+  /**
+   * @brief Get all faces
+   * @return Faces
+   */
+  std::span<const Face> faces() const;
+
+  /**
+   * @brief Get all vertices
+   * @return Vertices
+   */
+  std::span<const Vertex> vertices() const;
+
+  /**
+   * @brief Get all triangle indices
+   * @return Indices
+   */
+  std::span<const uint32_t> indices() const;
+
+  /**
+   * @brief Get the vertex data revision, incremented each time a face is added
+   * @return Revision
+   */
+  int32_t revision() const;
+
+  /**
+   * @brief Get the render buffers holding the uploaded vertex data
+   * @return Render buffers
+   */
+  Buffers& buffers();
+
+  /**
+   * @brief Sort render order by depth along the provided vector direction, farthest to closest.
+   * Depth keys are computed once per item, items at equal depth keep their last order
    * @param dir Direction to use
+   * @param mode Sort algorithm, use Coherent when the direction changes little between calls
+   */
+  void sort_by_depth(const ares::dvec3& dir, Sort mode = Sort::Radix);
+
+  /**
+   * @brief Get the render order, items farthest to closest after sorting
+   * @return Render order
    */
-  void sort_by_depth(const ares::dvec3& dir);
+  std::span<const Item> order() const;
+
+  /**
+   * @brief Get a face mid (center) point in world cs, up to date after sorting
+   * @param face Face index
+   * @return Mid point
+   */
+  ares::dvec3 wcs_mid(int32_t face) const;
 
   // Part const iterator
   struct Citer;
 
   /**
-   * @brief Returns an iterator to the beginning of all faces in render order
+   * @brief Returns an iterator to the beginning of all faces in render order, convex parts faces
+   * are in the order they were added
    * @return Begin iterator
    */
   Citer begin() const;
@@ -98,21 +224,81 @@ public:
 
 private:
 
+  /**
+   * @brief Add the triangle indices of a new face to the last added part, call before adding the
+   * face vertices
+   * @param is_quad Face is quad and is split in 2 triangles, else 1 triangle
+   */
+  void add_indices(bool is_quad);
+
+  /**
+   * @brief Add the mid point and render order item of a new face for the last added part
+   * @param mid Mid point in local cs
+   */
+  void add_mid(const ares::dvec3& mid);
+
+  /**
+   * @brief Mark a part as moved so that its faces mid points are updated on the next sort and its
+   * world cs bounding box on the next request
+   * @param part Part index
+   */
+  void mark_dirty(int32_t part);
+
+  /**
+   * @brief Update the world cs mid points of the faces of all moved parts
+   */
+  void update_mids();
+
+  /**
+   * @brief Insertion sort the render order by the items depth keys
+   * @param max_moves Max number of element moves after which sorting stops
+   * @return True if sorted, false if stopped, order is left partially sorted
+   */
+  bool insertion_sort(size_t max_moves);
+
   // aqua parts
   std::vector<Part> _parts;
   // aqua faces
   std::vector<Face> _faces;
   // all vertices
   std::vector<Vertex> _vertices;
+  // triangle indices into vertices
+  std::vector<uint32_t> _indices;
+  // vertex data revision
+  int32_t _revision{0};
+  // render buffers
+  Buffers _buffers;
   // render order
-  std::vector<int32_t> _order;
+  std::vector<Item> _order;
+  // radix sort scratch buffer
+  std::vector<Item> _scratch;
+  // per face mid points in local cs
+  ares::dvec3_soa _local_mids;
+  // per face mid points in world cs
+  ares::dvec3_soa _mids;
+  // per face mid points depths along the last sort direction
+  std::vector<double> _depths;
+  // moved parts waiting for a mid points update
+  std::vector<int32_t> _dirty;
+  // per part flag set while the part is in the moved list
+  std::vector<uint8_t> _is_dirty;
+  // world cs bounding boxes
+  Part_bounds _bounds;
 };
 
 
 
-inline void Glass_parts::add_part(Texture tex, Blend blend, const ares::dcs3& cs)
+inline void Glass_parts::add_part(Texture tex, Blend blend, const ares::dcs3& cs, bool convex)
 {
-  _parts.push_back({.tex = tex, .blend = blend, .mat = ares::dmatrix::make_from(cs)});
+  _parts.push_back(
+    {.tex = tex,
+     .blend = blend,
+     .mat = ares::dmatrix::make_from(cs),
+     .fbegin = static_cast<int32_t>(_faces.size()),
+     .ibegin = static_cast<int32_t>(_indices.size()),
+     .convex = convex});
+  _is_dirty.push_back(0);
+  _bounds.add_part();
 }
 
 
@@ -125,8 +311,11 @@ inline void Glass_parts::add_face(
      .norm = normal,
      .is_quad = false,
      .vbegin = static_cast<int32_t>(_vertices.size()),
-     .wcs_mid = _parts.back().mat.transform_p((v0.pos + v1.pos + v2.pos) / 3)});
-  _order.push_back(static_cast<int32_t>(_faces.size()) - 1);
+     .ibegin = static_cast<int32_t>(_indices.size())});
+  add_mid((v0.pos + v1.pos + v2.pos) / 3);
+  add_indices(false);
+  _parts.back().bbox.extend({v0.pos, v1.pos, v2.pos});
+  _bounds.mark_changed(static_cast<int32_t>(_parts.size()) - 1);
   _vertices.insert(_vertices.end(), {v0, v1, v2});
 }
 
@@ -140,18 +329,217 @@ inline void Glass_parts::add_face(
      .norm = normal,
      .is_quad = true,
      .vbegin = static_cast<int32_t>(_vertices.size()),
-     .wcs_mid = _parts.back().mat.transform_p((v0.pos + v1.pos + v2.pos + v3.pos) / 4)});
-  _order.push_back(static_cast<int32_t>(_faces.size()) - 1);
+     .ibegin = static_cast<int32_t>(_indices.size())});
+  add_mid((v0.pos + v1.pos + v2.pos + v3.pos) / 4);
+  add_indices(true);
+  _parts.back().bbox.extend({v0.pos, v1.pos, v2.pos, v3.pos});
+  _bounds.mark_changed(static_cast<int32_t>(_parts.size()) - 1);
   _vertices.insert(_vertices.end(), {v0, v1, v2, v3});
 }
 
 
 
-inline void Glass_parts::sort_by_depth(const ares::dvec3& dir)
+inline void Glass_parts::set_matrix(int32_t part, const ares::dmatrix& mat)
+{
+  _parts[part].mat = mat;
+  mark_dirty(part);
+}
+
+
+
+inline void Glass_parts::set_origin(int32_t part, const ares::dvec3& origin)
+{
+  _parts[part].mat.set_origin(origin);
+  mark_dirty(part);
+}
+
+
+
+inline std::span<const Glass_parts::Part> Glass_parts::parts() const
+{
+  return _parts;
+}
+
+
+
+inline const ares::Bbox3_soa& Glass_parts::world_boxes()
+{
+  return _bounds.update<Part>(_parts);
+}
+
+
+
+inline int32_t Glass_parts::cull(const ares::Frustum& frustum, std::span<ares::Visibility> result)
 {
-  const auto cmp = [&dir, this](int32_t el1, int32_t el2)
-  { return _faces[el1].wcs_mid.dot(dir) > _faces[el2].wcs_mid.dot(dir); };
-  std::sort(_order.begin(), _order.end(), cmp);
+  return ares::cull(frustum, world_boxes(), _bounds.rejecting_planes(), result);
+}
+
+
+
+inline std::span<const Glass_parts::Face> Glass_parts::faces() const
+{
+  return _faces;
+}
+
+
+
+inline std::span<const Vertex> Glass_parts::vertices() const
+{
+  return _vertices;
+}
+
+
+
+inline std::span<const uint32_t> Glass_parts::indices() const
+{
+  return _indices;
+}
+
+
+
+inline int32_t Glass_parts::revision() const
+{
+  return _revision;
+}
+
+
+
+inline Buffers& Glass_parts::buffers()
+{
+  return _buffers;
+}
+
+
+
+inline void Glass_parts::add_indices(bool is_quad)
+{
+  const auto vbegin = static_cast<uint32_t>(_vertices.size());
+  _indices.insert(_indices.end(), {vbegin, vbegin + 1, vbegin + 2});
+  if (is_quad)
+  {
+    _indices.insert(_indices.end(), {vbegin, vbegin + 2, vbegin + 3});
+  }
+  _parts.back().icount = static_cast<int32_t>(_indices.size()) - _parts.back().ibegin;
+  ++_revision;
+}
+
+
+
+inline void Glass_parts::add_mid(const ares::dvec3& mid)
+{
+  // convex parts get a single render order item with their first face
+  auto& part = _parts.back();
+  const auto part_index = static_cast<int32_t>(_parts.size()) - 1;
+  if (!part.convex)
+  {
+    _order.push_back({.part = part_index, .face = static_cast<int32_t>(_faces.size()) - 1});
+  }
+  else if (0 == part.fcount)
+  {
+    _order.push_back({.part = part_index});
+  }
+  ++part.fcount;
+  part.center += (mid - part.center) / part.fcount;
+
+  _local_mids.push_back(mid);
+  _mids.push_back(part.mat.transform_p(mid));
+}
+
+
+
+inline void Glass_parts::mark_dirty(int32_t part)
+{
+  _bounds.mark_changed(part);
+  if (0 == _is_dirty[part])
+  {
+    _is_dirty[part] = 1;
+    _dirty.push_back(part);
+  }
+}
+
+
+
+inline void Glass_parts::update_mids()
+{
+  for (const auto index : _dirty)
+  {
+    const auto& part = _parts[index];
+    ares::transform(_local_mids, part.mat, _mids, part.fbegin, part.fcount);
+    _is_dirty[index] = 0;
+  }
+  _dirty.clear();
+}
+
+
+
+inline void Glass_parts::sort_by_depth(const ares::dvec3& dir, Sort mode)
+{
+  update_mids();
+
+  // all faces depths at once, the convex parts ones are not used
+  _depths.resize(_mids.size());
+  ares::dot(_mids, dir, std::span<double>(_depths));
+
+  // flipped keys so that ascending order is farthest to closest
+  for (auto& item : _order)
+  {
+    double depth = 0;
+    if (item.face < 0)
+    {
+      const auto& part = _parts[item.part];
+      depth = part.mat.transform_p(part.center).dot(dir);
+    }
+    else
+    {
+      depth = _depths[item.face];
+    }
+    item.key = ~ares::float_key(static_cast<float>(depth));
+  }
+
+  // a nearly sorted order takes few moves, past a few moves per item radix sort is faster
+  if (Sort::Coherent == mode && insertion_sort(4 * _order.size()))
+  {
+    return;
+  }
+  ares::radix_sort(_order, _scratch, [](const Item& item) { return item.key; });
+}
+
+
+
+inline bool Glass_parts::insertion_sort(size_t max_moves)
+{
+  size_t moves = 0;
+  for (size_t i = 1; i < _order.size(); ++i)
+  {
+    const auto item = _order[i];
+    auto j = i;
+    for (; j > 0 && _order[j - 1].key > item.key; --j)
+    {
+      _order[j] = _order[j - 1];
+    }
+    _order[j] = item;
+
+    moves += i - j;
+    if (moves > max_moves)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+
+inline std::span<const Glass_parts::Item> Glass_parts::order() const
+{
+  return _order;
+}
+
+
+
+inline ares::dvec3 Glass_parts::wcs_mid(int32_t face) const
+{
+  return _mids.get(face);
 }
 
 
@@ -165,7 +553,9 @@ struct Glass_parts::Citer
   // vertex begin iterator
   std::vector<Vertex>::const_iterator vbegin;
   // order iterator
-  std::vector<int32_t>::const_iterator order_it;
+  std::vector<Item>::const_iterator order_it;
+  // face offset inside a convex part item
+  int32_t offset{0};
 
   /**
    * @brief Equality operator
@@ -219,7 +609,7 @@ inline Glass_parts::Citer Glass_parts::end() const
 
 inline bool Glass_parts::Citer::operator==(const Citer& other) const
 {
-  return order_it == other.order_it;
+  return order_it == other.order_it && offset == other.offset;
 }
 
 
@@ -234,8 +624,8 @@ inline bool Glass_parts::Citer::operator!=(const Citer& other) const
 inline std::tuple<const Glass_parts::Part&, const Glass_parts::Face&, std::span<const Vertex>>
 Glass_parts::Citer::operator*()
 {
-  const auto face_it = fbegin + *order_it;
-  const auto part_it = pbegin + face_it->part;
+  const auto part_it = pbegin + order_it->part;
+  const auto face_it = fbegin + (order_it->face < 0 ? part_it->fbegin + offset : order_it->face);
   const auto vert_it = vbegin + face_it->vbegin;
   return {*part_it, *face_it, {vert_it, vert_it + 3 + face_it->is_quad}};
 }
@@ -244,6 +634,11 @@ Glass_parts::Citer::operator*()
 
 inline void Glass_parts::Citer::operator++()
 {
+  if (order_it->face < 0 && ++offset < (pbegin + order_it->part)->fcount)
+  {
+    return;
+  }
+  offset = 0;
   order_it++;
 }
 
@@ -0,0 +1,270 @@
+#ifndef __HERA_INSTANCED_PARTS_H__
+#define __HERA_INSTANCED_PARTS_H__
+
+#include "buffers.h"
+#include "color.h"
+#include "texture.h"
+#include "vertex.h"
+
+#include <ares/affine3.h>
+#include <span>
+#include <vector>
+
+namespace hera
+{
+
+/**
+ * @brief Instanced solid (opaque) 3D object part, a single mesh rendered at many transforms. Mesh
+ * data is stored once, memory grows only with the number of instances
+ */
+class Instanced_parts
+{
+public:
+
+  struct Instance
+  {
+    // transform from object local cs, streamed each frame so it is kept compact
+    ares::Affine3 mat;
+    // color multiplied with the mesh vertex colors
+    ubColor color{.r = 255, .g = 255, .b = 255, .a = 255};
+  };
+
+  struct Face
+  {
+    // face normal
+    ares::fvec3 norm;
+    // face is quad and has 4 vertices, else 3
+    bool is_quad{false};
+    // vertex begin index
+    int32_t vbegin{0};
+    // index begin index, faces are triangulated, 3 indices for triangles and 6 for quads
+    int32_t ibegin{0};
+  };
+
+  /**
+   * @brief Set the mesh texture
+   * @param tex Texture to set
+   */
+  void set_texture(Texture tex);
+
+  /**
+   * @brief Get the mesh texture
+   * @return Texture
+   */
+  Texture texture() const;
+
+  /**
+   * @brief Add a mesh face
+   * @param normal Face normal
+   * @param v0 Face vertex
+   * @param v1 Face vertex
+   * @param v2 Face vertex
+   */
+  void add_face(const ares::fvec3& normal, const Vertex& v0, const Vertex& v1, const Vertex& v2);
+
+  /**
+   * @brief Add a mesh face
+   * @param normal Face normal
+   * @param v0 Face vertex
+   * @param v1 Face vertex
+   * @param v2 Face vertex
+   * @param v3 Face vertex
+   */
+  void add_face(
+    const ares::fvec3& normal,
+    const Vertex& v0,
+    const Vertex& v1,
+    const Vertex& v2,
+    const Vertex& v3);
+
+  /**
+   * @brief Add an instance of the mesh
+   * @param cs Instance local cs
+   * @param color Instance color
+   * @return Index of the added instance
+   */
+  int32_t add_instance(
+    const ares::dcs3& cs, ubColor color = {.r = 255, .g = 255, .b = 255, .a = 255});
+
+  /**
+   * @brief Get the instance at the provided index
+   * @param index Index to use
+   * @return Requested instance
+   */
+  Instance& get_instance(int index);
+
+  /**
+   * @brief Get all instances, streamed to the renderer each frame
+   * @return Instances
+   */
+  std::span<const Instance> instances() const;
+
+  /**
+   * @brief Get all mesh faces
+   * @return Faces
+   */
+  std::span<const Face> faces() const;
+
+  /**
+   * @brief Get all mesh vertices
+   * @return Vertices
+   */
+  std::span<const Vertex> vertices() const;
+
+  /**
+   * @brief Get all mesh triangle indices
+   * @return Indices
+   */
+  std::span<const uint32_t> indices() const;
+
+  /**
+   * @brief Get the mesh vertex data revision, incremented each time a face is added
+   * @return Revision
+   */
+  int32_t revision() const;
+
+  /**
+   * @brief Get the render buffers holding the uploaded mesh and instance data
+   * @return Render buffers
+   */
+  Buffers& buffers();
+
+private:
+
+  /**
+   * @brief Add the triangle indices of a new face, call before adding the face vertices
+   * @param is_quad Face is quad and is split in 2 triangles, else 1 triangle
+   */
+  void add_indices(bool is_quad);
+
+  // mesh texture
+  Texture _tex;
+  // mesh faces
+  std::vector<Face> _faces;
+  // mesh vertices
+  std::vector<Vertex> _vertices;
+  // mesh triangle indices into vertices
+  std::vector<uint32_t> _indices;
+  // mesh instances
+  std::vector<Instance> _instances;
+  // mesh vertex data revision
+  int32_t _revision{0};
+  // render buffers
+  Buffers _buffers;
+};
+
+
+
+inline void Instanced_parts::set_texture(Texture tex)
+{
+  _tex = tex;
+}
+
+
+
+inline Texture Instanced_parts::texture() const
+{
+  return _tex;
+}
+
+
+
+inline void Instanced_parts::add_face(
+  const ares::fvec3& normal, const Vertex& v0, const Vertex& v1, const Vertex& v2)
+{
+  _faces.push_back(
+    {.norm = normal,
+     .is_quad = false,
+     .vbegin = static_cast<int32_t>(_vertices.size()),
+     .ibegin = static_cast<int32_t>(_indices.size())});
+  add_indices(false);
+  _vertices.insert(_vertices.end(), {v0, v1, v2});
+}
+
+
+
+inline void Instanced_parts::add_face(
+  const ares::fvec3& normal, const Vertex& v0, const Vertex& v1, const Vertex& v2, const Vertex& v3)
+{
+  _faces.push_back(
+    {.norm = normal,
+     .is_quad = true,
+     .vbegin = static_cast<int32_t>(_vertices.size()),
+     .ibegin = static_cast<int32_t>(_indices.size())});
+  add_indices(true);
+  _vertices.insert(_vertices.end(), {v0, v1, v2, v3});
+}
+
+
+
+inline int32_t Instanced_parts::add_instance(const ares::dcs3& cs, ubColor color)
+{
+  _instances.push_back({.mat = ares::Affine3::make_from(cs), .color = color});
+  return static_cast<int32_t>(_instances.size()) - 1;
+}
+
+
+
+inline Instanced_parts::Instance& Instanced_parts::get_instance(int index)
+{
+  return _instances[index];
+}
+
+
+
+inline std::span<const Instanced_parts::Instance> Instanced_parts::instances() const
+{
+  return _instances;
+}
+
+
+
+inline std::span<const Instanced_parts::Face> Instanced_parts::faces() const
+{
+  return _faces;
+}
+
+
+
+inline std::span<const Vertex> Instanced_parts::vertices() const
+{
+  return _vertices;
+}
+
+
+
+inline std::span<const uint32_t> Instanced_parts::indices() const
+{
+  return _indices;
+}
+
+
+
+inline int32_t Instanced_parts::revision() const
+{
+  return _revision;
+}
+
+
+
+inline Buffers& Instanced_parts::buffers()
+{
+  return _buffers;
+}
+
+
+
+inline void Instanced_parts::add_indices(bool is_quad)
+{
+  const auto vbegin = static_cast<uint32_t>(_vertices.size());
+  _indices.insert(_indices.end(), {vbegin, vbegin + 1, vbegin + 2});
+  if (is_quad)
+  {
+    _indices.insert(_indices.end(), {vbegin, vbegin + 2, vbegin + 3});
+  }
+  ++_revision;
+}
+
+} // namespace hera
+
+#endif //__HERA_INSTANCED_PARTS_H__
@@ -2,13 +2,63 @@
 
 #include "../glass_parts.h"
 #include "../image.h"
+#include "../instanced_parts.h"
 #include "../light.h"
 #include "../solid_parts.h"
 #include "heragl.h"
+#include "shaders.h"
+
+#include <ares/mesh.h>
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
 
 namespace
 {
 
+// render vertex layout, 24 bytes, the face normal is copied into each vertex
+struct Gl_vertex
+{
+  // vertex position
+  float pos[3];
+  // vertex normal as signed normalized bytes, the 4th byte pads the normal to 4 bytes
+  int8_t norm[4];
+  // texture coord as half floats
+  uint16_t tex[2];
+  // vertex color
+  uint8_t color[4];
+};
+
+static_assert(sizeof(Gl_vertex) == 24, "render vertex must stay packed");
+
+/**
+ * @brief Convert a float to a signed normalized byte
+ * @param value Value in the [-1, 1] interval
+ * @return Rounded value scaled to the [-127, 127] interval
+ */
+int8_t to_snorm8(float value);
+
+/**
+ * @brief Convert a float to a half float, rounded to nearest even
+ * @param value Value to convert, overflows to infinity past the half range
+ * @return Half float bits
+ */
+uint16_t to_half(float value);
+
+/**
+ * @brief Get the renderbuffer format matching a framebuffer depth and stencil
+ * @param depth_bits Depth bits
+ * @param stencil_bits Stencil bits
+ * @param float_depth Depth is stored as float
+ * @return Format, GL_NONE if there is no depth or no matching format
+ */
+GLenum oit_depth_format(GLint depth_bits, GLint stencil_bits, bool float_depth);
+
 template <typename T>
 concept Part = requires(T t) {
   { t.tex } -> std::same_as<hera::Texture&>;
@@ -16,21 +66,76 @@ concept Part = requires(T t) {
 };
 
 template <typename T>
-concept Face = requires(T t) {
-  { t.norm } -> std::same_as<ares::fvec3&>;
-  { t.is_quad } -> std::same_as<bool&>;
+concept Parts = requires(T t) {
+  { t.faces() };
+  { t.vertices() } -> std::same_as<std::span<const hera::Vertex>>;
+  { t.indices() } -> std::same_as<std::span<const uint32_t>>;
+  { t.revision() } -> std::same_as<int32_t>;
+  { t.buffers() } -> std::same_as<hera::Buffers&>;
 };
 
 /**
- * @brief Render face
+ * @brief Upload parts vertices and indices to the render buffers if they changed since the last
+ * upload, creates the buffers on first use
+ * @tparam T Parts type
+ * @param parts Parts to upload
+ * @return True if GL was called, vertex array 0 is left bound, false if nothing changed
+ */
+template <Parts T>
+bool upload_parts(T& parts);
+
+/**
+ * @brief Upload the vertex data of the provided parts if required and stream their instance data,
+ * creates the instance buffer on first use
+ * @param parts Parts to upload
+ * @return True if GL was called, vertex array 0 is left bound, false if there is nothing to render
+ */
+bool upload_instances(hera::Instanced_parts& parts);
+
+/**
+ * @brief Render all instances of the provided parts with the currently used instanced program,
+ * bound vertex array and texture
+ * @param parts Parts to render
+ * @param buffers Bound buffers of the parts
+ * @param textured_loc Texture enabled uniform location
+ */
+void render_instances(
+  const hera::Instanced_parts& parts, const hera::Buffers& buffers, GLint textured_loc);
+
+/**
+ * @brief Get the GL type of the uploaded indices
+ * @param buffers Buffers the indices were uploaded to
+ * @return GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+ */
+GLenum index_type(const hera::Buffers& buffers);
+
+/**
+ * @brief Render a range of part triangles from the currently bound buffers and texture, the part
+ * matrix is set once for the whole range
  * @tparam P Part type
- * @tparam F Face type
- * @param part Part that the face belongs to
- * @param face Face to render
- * @param vertices Face vertices
+ * @param part Part that the triangles belong to
+ * @param buffers Bound buffers
+ * @param ibegin First index of the range
+ * @param icount Number of indices in the range
  */
-template <Part P, Face F>
-void render_face(const P& part, const F& face, std::span<const hera::Vertex> vertices);
+template <Part P>
+void render_range(const P& part, const hera::Buffers& buffers, int32_t ibegin, int32_t icount);
+
+/**
+ * @brief Render several ranges of part triangles from the currently bound buffers and texture with
+ * one draw call, the part matrix is set once for all ranges
+ * @tparam P Part type
+ * @param part Part that the triangles belong to
+ * @param buffers Bound buffers
+ * @param counts Number of indices of each range
+ * @param offsets Index buffer byte offset of each range
+ */
+template <Part P>
+void render_ranges(
+  const P& part,
+  const hera::Buffers& buffers,
+  std::span<const int32_t> counts,
+  std::span<const void* const> offsets);
 
 } // namespace
 
@@ -60,27 +165,80 @@ Renderer::Renderer()
   _lights[5] = GL_LIGHT5;
   _lights[6] = GL_LIGHT6;
   _lights[7] = GL_LIGHT7;
+
+  _caps[Cap::blend] = GL_BLEND;
+  _caps[Cap::lighting] = GL_LIGHTING;
+  _caps[Cap::color_material] = GL_COLOR_MATERIAL;
+  _caps[Cap::texture_2d] = GL_TEXTURE_2D;
+  _caps[Cap::depth_test] = GL_DEPTH_TEST;
+  _caps[Cap::offset_fill] = GL_POLYGON_OFFSET_FILL;
+  _caps[Cap::culling] = GL_CULL_FACE;
 }
 
 
 
-void Renderer::basic_scene_setup() const
+void Renderer::basic_scene_setup()
 {
-  glEnable(GL_TEXTURE_2D);
+  set_cap(Cap::texture_2d, true);
   glShadeModel(GL_SMOOTH);
   glClearColor(0, 0, 0, 1);
   glClearDepth(1);
-  glEnable(GL_DEPTH_TEST);
+  set_cap(Cap::depth_test, true);
   glDepthFunc(GL_LESS);
-  glEnable(GL_POLYGON_OFFSET_FILL);
+  set_cap(Cap::offset_fill, true);
   glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
+
+  if (0 == _inst_program)
+  {
+    const GLuint program = make_program(
+      instanced_vs,
+      instanced_fs,
+      {{inst_mat_attrib, "inst_row0"},
+       {inst_mat_attrib + 1, "inst_row1"},
+       {inst_mat_attrib + 2, "inst_row2"},
+       {inst_color_attrib, "inst_color"}});
+    _inst_program = static_cast<int32_t>(program);
+    _inst_textured = 0 != program ? glGetUniformLocation(program, "textured") : -1;
+    _inst_lights = 0 != program ? glGetUniformLocation(program, "lights") : -1;
+  }
+
+  if (0 == _oit_program)
+  {
+    const GLuint program = make_program(
+      instanced_vs,
+      oit_fs,
+      {{inst_mat_attrib, "inst_row0"},
+       {inst_mat_attrib + 1, "inst_row1"},
+       {inst_mat_attrib + 2, "inst_row2"},
+       {inst_color_attrib, "inst_color"}},
+      {{0, "accum"}, {1, "weight"}});
+    _oit_program = static_cast<int32_t>(program);
+    _oit_textured = 0 != program ? glGetUniformLocation(program, "textured") : -1;
+    _oit_lights = 0 != program ? glGetUniformLocation(program, "lights") : -1;
+  }
+
+  if (0 == _composite_program)
+  {
+    const GLuint program = make_program(composite_vs, composite_fs, {});
+    if (0 != program)
+    {
+      // samplers never change, set them once
+      glUseProgram(program);
+      glUniform1i(glGetUniformLocation(program, "accum_unit"), 0);
+      glUniform1i(glGetUniformLocation(program, "weight_unit"), 1);
+      glUseProgram(0);
+      _state.program = 0;
+    }
+    _composite_program = static_cast<int32_t>(program);
+  }
 }
 
 
 
-void Renderer::basic_start_scene() const
+void Renderer::basic_start_scene()
 {
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  matrix_mode(GL_MODELVIEW);
   glLoadIdentity();
 }
 
@@ -97,11 +255,13 @@ void Renderer::set_viewport(int32_t x, int32_t y, int32_t width, int32_t height)
 
 
 
-void Renderer::set_perspective(
-  bool push_mvp, double fov, double aspect, double znear, double zfar) const
+void Renderer::set_perspective(bool push_mvp, double fov, double aspect, double znear, double zfar)
 {
+  _znear = znear;
+  _zfar = zfar;
+
   // Select the projection matrix, store it if required and reset it
-  glMatrixMode(GL_PROJECTION);
+  matrix_mode(GL_PROJECTION);
   if (push_mvp)
   {
     glPushMatrix();
@@ -112,7 +272,7 @@ void Renderer::set_perspective(
   gluPerspective(fov, aspect, znear, zfar);
 
   // Select the modelview matrix, store it if required and reset it
-  glMatrixMode(GL_MODELVIEW);
+  matrix_mode(GL_MODELVIEW);
   if (push_mvp)
   {
     glPushMatrix();
@@ -134,20 +294,37 @@ const ares::dvec3 Renderer::un_project(double winx, double winy, double winz) co
 
 
 
-void Renderer::look_at(
-  const ares::dvec3& eye, const ares::dvec3& center, const ares::dvec3& up) const
+void Renderer::look_at(const ares::dvec3& eye, const ares::dvec3& center, const ares::dvec3& up)
 {
+  _eye = eye;
+  _view_dir = (center - eye).make_normalized();
+  matrix_mode(GL_MODELVIEW);
   gluLookAt(eye.x, eye.y, eye.z, center.x, center.y, center.z, up.x, up.y, up.z);
 }
 
 
 
-Texture Renderer::create_texture(const Image& img, Texture::Min min, Texture::Mag mag) const
+void Renderer::set_frustum(const ares::Frustum& frustum)
+{
+  _frustum = frustum;
+  _has_frustum = true;
+}
+
+
+
+void Renderer::use_culling(bool enable)
+{
+  _culling = enable;
+}
+
+
+
+Texture Renderer::create_texture(const Image& img, Texture::Min min, Texture::Mag mag)
 {
   GLuint tex = 0;
   glGenTextures(1, &tex);
 
-  glBindTexture(GL_TEXTURE_2D, tex);
+  bind_texture({.id = static_cast<int32_t>(tex)});
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, _filter[static_cast<int>(min)]);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, _filter[static_cast<int>(mag)]);
 
@@ -176,49 +353,305 @@ Texture Renderer::create_texture(const Image& img, Texture::Min min, Texture::Ma
       img.data());
   }
 
-  glBindTexture(GL_TEXTURE_2D, 0);
+  bind_texture({});
   return {.id = static_cast<int32_t>(tex)};
 }
 
 
 
-void Renderer::render_parts(const Solid_parts& solids, const Glass_parts& glassy)
+void Renderer::bind_texture(Texture tex)
 {
-  for (const auto [part, face, vertices] : solids)
+  if (_state.tex == tex.id)
   {
-    render_face(part, face, vertices);
+    ++_stats.texture_binds_avoided;
+    return;
   }
 
-  glEnable(GL_BLEND);
-  for (const auto [part, face, vertices] : glassy)
-  {
-    glBlendFunc(_blend[part.blend.src], _blend[part.blend.dst]);
-    render_face(part, face, vertices);
-  }
-  glDisable(GL_BLEND);
+  glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(tex.id));
+  _state.tex = tex.id;
+  ++_stats.texture_binds;
+  check_state();
 }
 
 
 
-constexpr int32_t Renderer::max_lights() const
+void Renderer::invalidate_state()
 {
-  return static_cast<int32_t>(_lights.max_size());
+  _state = {};
 }
 
 
 
-void Renderer::use_lighting(bool enable) const
+void Renderer::render_parts(Solid_parts& solids, Glass_parts& glassy)
 {
-  if (enable)
+  render_parts(solids, {}, glassy);
+}
+
+
+
+void Renderer::render_parts(
+  Solid_parts& solids, std::span<Instanced_parts> instanced, Glass_parts& glassy)
+{
+  _stats = {};
+  check_state();
+
+  // uploads bind buffers directly, vertex array 0 is left bound if anything was uploaded
+  bool uploaded = upload_parts(solids);
+  uploaded |= upload_parts(glassy);
+  if (0 != _inst_program)
+  {
+    for (auto& parts : instanced)
+    {
+      uploaded |= upload_instances(parts);
+    }
+  }
+  if (uploaded)
+  {
+    _state.vao = 0;
+  }
+
+  // queue solids by texture then front to back, instanced by texture, glass in sorted order or
+  // by blend and texture when the order does not matter
+  const bool oit = Transparency::Weighted_oit == _transparency && prepare_oit();
+  _queue.clear();
+
+  // parts fully outside of the view frustum are not queued, parts without faces count as outside
+  const bool cull = _culling && _has_frustum;
+  const auto planes = _frustum.compute_planes();
+  const auto count_culled = [&](const std::vector<ares::Visibility>& visibility)
+  {
+    _stats.culled += static_cast<int32_t>(
+      std::count(visibility.begin(), visibility.end(), ares::Visibility::Outside));
+  };
+
+  // static solids are culled through their hierarchy, movable solids through their dynamic tree
+  const auto solid_parts = solids.parts();
+  if (cull)
+  {
+    _solids_visibility.assign(solid_parts.size(), ares::Visibility::Outside);
+    const auto static_parts = solids.static_parts();
+    solids.static_bvh().cull(
+      planes,
+      [&](int32_t prim, ares::Visibility vis) { _solids_visibility[static_parts[prim]] = vis; });
+
+    solids.movable_tree().cull(
+      planes, [&](int32_t part, ares::Visibility vis) { _solids_visibility[part] = vis; });
+    count_culled(_solids_visibility);
+  }
+  else
+  {
+    _solids_visibility.assign(solid_parts.size(), ares::Visibility::Inside);
+  }
+  for (int32_t i = 0; i < static_cast<int32_t>(solid_parts.size()); ++i)
+  {
+    if (ares::Visibility::Outside == _solids_visibility[i])
+    {
+      continue;
+    }
+
+    const auto& part = solid_parts[i];
+    const ares::dvec3 origin{.x = part.mat[12], .y = part.mat[13], .z = part.mat[14]};
+    const auto depth = Render_queue::depth_bucket((origin - _eye).dot(_view_dir), _znear, _zfar);
+    _queue.add(Render_queue::opaque_key(Render_queue::Solid, part.tex.id, depth), i);
+  }
+
+  if (0 != _inst_program)
+  {
+    for (int32_t i = 0; i < static_cast<int32_t>(instanced.size()); ++i)
+    {
+      _queue.add(
+        Render_queue::opaque_key(Render_queue::Instanced, instanced[i].texture().id, 0), i);
+    }
+  }
+
+  const auto glass_parts = glassy.parts();
+  const auto glass_faces = glassy.faces();
+  const auto glass_order = glassy.order();
+  _glass_visibility.assign(glass_parts.size(), ares::Visibility::Inside);
+  if (cull)
   {
-    glEnable(GL_LIGHTING);
-    glEnable(GL_COLOR_MATERIAL);
+    _stats.plane_tests += glassy.cull(_frustum, _glass_visibility);
+    _stats.cull_tested += static_cast<int32_t>(glass_parts.size());
+    count_culled(_glass_visibility);
+  }
+  if (oit)
+  {
+    for (int32_t i = 0; i < static_cast<int32_t>(glass_parts.size()); ++i)
+    {
+      if (ares::Visibility::Outside == _glass_visibility[i])
+      {
+        continue;
+      }
+
+      const auto& part = glass_parts[i];
+      _queue.add(Render_queue::glass_key(0, part.blend, part.tex.id), i);
+    }
   }
   else
   {
-    glDisable(GL_COLOR_MATERIAL);
-    glDisable(GL_LIGHTING);
+    for (int32_t i = 0; i < static_cast<int32_t>(glass_order.size()); ++i)
+    {
+      if (ares::Visibility::Outside == _glass_visibility[glass_order[i].part])
+      {
+        continue;
+      }
+
+      const auto& part = glass_parts[glass_order[i].part];
+      _queue.add(Render_queue::glass_key(i, part.blend, part.tex.id), i);
+    }
+  }
+
+  _queue.sort();
+
+  matrix_mode(GL_MODELVIEW);
+  int32_t pass = -1;
+  const auto draws = _queue.draws();
+  for (size_t d = 0; d < draws.size(); ++d)
+  {
+    const auto& draw = draws[d];
+    // passes come in increasing order, set up the pass state on the first draw of each pass
+    if (const auto draw_pass = Render_queue::pass(draw.key); draw_pass != pass)
+    {
+      pass = draw_pass;
+      if (Render_queue::Solid == pass)
+      {
+        bind_vertex_array(solids.buffers().vao);
+      }
+      else if (Render_queue::Instanced == pass)
+      {
+        // fixed function lighting does not apply to shaders, pass the enabled lights instead
+        use_program(_inst_program);
+        glUniform1i(_inst_lights, lights_mask());
+      }
+      else if (oit)
+      {
+        begin_oit();
+        bind_vertex_array(glassy.buffers().vao);
+      }
+      else
+      {
+        use_program(0);
+        bind_vertex_array(glassy.buffers().vao);
+        set_cap(Cap::blend, true);
+      }
+    }
+
+    if (Render_queue::Solid == pass)
+    {
+      const auto& part = solid_parts[draw.item];
+      bind_texture(part.tex);
+      render_range(part, solids.buffers(), part.ibegin, part.icount);
+    }
+    else if (Render_queue::Instanced == pass)
+    {
+      auto& parts = instanced[draw.item];
+      bind_vertex_array(parts.buffers().vao);
+      bind_texture(parts.texture());
+      render_instances(parts, parts.buffers(), _inst_textured);
+    }
+    else if (oit)
+    {
+      const auto& part = glass_parts[draw.item];
+      bind_texture(part.tex);
+      glUniform1i(_oit_textured, 0 != part.tex.id);
+      render_range(part, glassy.buffers(), part.ibegin, part.icount);
+    }
+    else
+    {
+      const auto& item = glass_order[draw.item];
+      const auto& part = glass_parts[item.part];
+      blend_func(part.blend);
+      bind_texture(part.tex);
+      if (item.face < 0)
+      {
+        // a convex part needs no face sort, its back faces are all behind its front faces
+        set_cap(Cap::culling, true);
+        cull_face(GL_FRONT);
+        render_range(part, glassy.buffers(), part.ibegin, part.icount);
+        cull_face(GL_BACK);
+        render_range(part, glassy.buffers(), part.ibegin, part.icount);
+        ++_stats.draws;
+      }
+      else
+      {
+        // the next faces of the same part share all state, merge them into one draw keeping their
+        // order, contiguous index ranges are merged into a single range
+        const auto& face = glass_faces[item.face];
+        const size_t index_size = glassy.buffers().index_size;
+        _counts.assign(1, 3 + 3 * face.is_quad);
+        int32_t iend = face.ibegin + _counts.back();
+        _offsets.assign(1, reinterpret_cast<const void*>(face.ibegin * index_size));
+        for (; d + 1 < draws.size(); ++d)
+        {
+          const auto& next = glass_order[draws[d + 1].item];
+          if (next.part != item.part || next.face < 0)
+          {
+            break;
+          }
+
+          const auto& next_face = glass_faces[next.face];
+          const int32_t count = 3 + 3 * next_face.is_quad;
+          if (iend != next_face.ibegin)
+          {
+            _counts.push_back(0);
+            _offsets.push_back(reinterpret_cast<const void*>(next_face.ibegin * index_size));
+          }
+          _counts.back() += count;
+          iend = next_face.ibegin + count;
+          ++_stats.merged_draws;
+        }
+
+        set_cap(Cap::culling, false);
+        render_ranges(part, glassy.buffers(), _counts, _offsets);
+      }
+    }
+    ++_stats.draws;
   }
+
+  if (oit && Render_queue::Glass == pass)
+  {
+    end_oit();
+  }
+  use_program(0);
+  set_cap(Cap::blend, false);
+  set_cap(Cap::culling, false);
+  bind_vertex_array(0);
+}
+
+
+
+void Renderer::set_transparency(Transparency mode)
+{
+  _transparency = mode;
+}
+
+
+
+Renderer::Transparency Renderer::transparency() const
+{
+  return _transparency;
+}
+
+
+
+const Render_stats& Renderer::stats() const
+{
+  return _stats;
+}
+
+
+
+constexpr int32_t Renderer::max_lights() const
+{
+  return static_cast<int32_t>(_lights.max_size());
+}
+
+
+
+void Renderer::use_lighting(bool enable)
+{
+  set_cap(Cap::lighting, enable);
+  set_cap(Cap::color_material, enable);
 }
 
 
@@ -250,18 +683,337 @@ bool Renderer::add_light(Light& light)
 
 
 
-void Renderer::set_light(const Light& light) const
+void Renderer::set_light(const Light& light)
 {
+  // the position is transformed by the current modelview matrix, always set it
   const auto pos = light.pos.xyzw();
   glLightfv(static_cast<GLenum>(_lights[light.id]), GL_POSITION, pos.data());
-  glEnable(static_cast<GLenum>(_lights[light.id]));
+  set_cap(Cap::light0 + light.id, true);
+}
+
+
+
+void Renderer::unset_light(const Light& light)
+{
+  set_cap(Cap::light0 + light.id, false);
+}
+
+
+
+void Renderer::blend_func(Blend blend)
+{
+  const auto src = _blend[blend.src];
+  const auto dst = _blend[blend.dst];
+  if (_state.blend_src == src && _state.blend_dst == dst)
+  {
+    ++_stats.blend_changes_avoided;
+    return;
+  }
+
+  glBlendFunc(static_cast<GLenum>(src), static_cast<GLenum>(dst));
+  _state.blend_src = src;
+  _state.blend_dst = dst;
+  ++_stats.blend_changes;
+  check_state();
+}
+
+
+
+void Renderer::set_cap(int32_t cap, bool enable)
+{
+  const uint32_t bit = 1u << cap;
+  if ((_state.known & bit) && enable == !!(_state.enabled & bit))
+  {
+    ++_stats.state_changes_avoided;
+    return;
+  }
+
+  const auto id =
+    static_cast<GLenum>(cap < Cap::light0 ? _caps[cap] : _lights[cap - Cap::light0]);
+  if (enable)
+  {
+    glEnable(id);
+    _state.enabled |= bit;
+  }
+  else
+  {
+    glDisable(id);
+    _state.enabled &= ~bit;
+  }
+  _state.known |= bit;
+  ++_stats.state_changes;
+  check_state();
+}
+
+
+
+bool Renderer::has_cap(int32_t cap) const
+{
+  return _state.known & _state.enabled & (1u << cap);
+}
+
+
+
+void Renderer::matrix_mode(int32_t mode)
+{
+  if (_state.matrix_mode == mode)
+  {
+    ++_stats.state_changes_avoided;
+    return;
+  }
+
+  glMatrixMode(static_cast<GLenum>(mode));
+  _state.matrix_mode = mode;
+  ++_stats.state_changes;
+  check_state();
+}
+
+
+
+void Renderer::cull_face(int32_t mode)
+{
+  if (_state.cull == mode)
+  {
+    ++_stats.state_changes_avoided;
+    return;
+  }
+
+  glCullFace(static_cast<GLenum>(mode));
+  _state.cull = mode;
+  ++_stats.state_changes;
+  check_state();
+}
+
+
+
+void Renderer::use_program(int32_t id)
+{
+  if (_state.program == id)
+  {
+    ++_stats.state_changes_avoided;
+    return;
+  }
+
+  glUseProgram(static_cast<GLuint>(id));
+  _state.program = id;
+  ++_stats.state_changes;
+  check_state();
+}
+
+
+
+void Renderer::bind_vertex_array(int32_t id)
+{
+  if (_state.vao == id)
+  {
+    ++_stats.state_changes_avoided;
+    return;
+  }
+
+  glBindVertexArray(static_cast<GLuint>(id));
+  _state.vao = id;
+  ++_stats.state_changes;
+  check_state();
+}
+
+
+
+int32_t Renderer::lights_mask() const
+{
+  int32_t lights = 0;
+  if (has_cap(Cap::lighting))
+  {
+    for (int32_t i = 0; i < _light_count; ++i)
+    {
+      lights |= has_cap(Cap::light0 + i) << i;
+    }
+  }
+  return lights;
+}
+
+
+
+bool Renderer::prepare_oit()
+{
+  if (0 == _oit_program || 0 == _composite_program)
+  {
+    return false;
+  }
+
+  // the targets cover the viewport at its position so the viewport applies unchanged
+  const int32_t width = _viewport[Vp::pos_x] + _viewport[Vp::width];
+  const int32_t height = _viewport[Vp::pos_y] + _viewport[Vp::height];
+  if (0 != _oit.fbo && width == _oit.width && height == _oit.height)
+  {
+    return _oit.valid;
+  }
+
+  if (0 == _oit.fbo)
+  {
+    GLuint fbo = 0;
+    GLuint textures[2] = {0};
+    GLuint depth = 0;
+    glGenFramebuffers(1, &fbo);
+    glGenTextures(2, textures);
+    glGenRenderbuffers(1, &depth);
+    _oit.fbo = static_cast<int32_t>(fbo);
+    _oit.accum = static_cast<int32_t>(textures[0]);
+    _oit.weight = static_cast<int32_t>(textures[1]);
+    _oit.depth = static_cast<int32_t>(depth);
+  }
+  _oit.width = width;
+  _oit.height = height;
+
+  // float targets, the accumulated values exceed 1
+  const auto make_target = [this, width, height](int32_t tex, GLint format, GLenum channels)
+  {
+    bind_texture({.id = tex});
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, channels, GL_FLOAT, nullptr);
+  };
+  make_target(_oit.accum, GL_RGBA16F, GL_RGBA);
+  make_target(_oit.weight, GL_R16F, GL_RED);
+  bind_texture({});
+
+  // depth is blitted only between equal formats, so the renderbuffer takes the depth and stencil
+  // sizes of the default framebuffer pixel format
+  GLint depth_bits = 0;
+  GLint stencil_bits = 0;
+  GLint depth_type = GL_NONE;
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glGetFramebufferAttachmentParameteriv(
+    GL_FRAMEBUFFER, GL_DEPTH, GL_FRAMEBUFFER_ATTACHMENT_DEPTH_SIZE, &depth_bits);
+  glGetFramebufferAttachmentParameteriv(
+    GL_FRAMEBUFFER, GL_STENCIL, GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE, &stencil_bits);
+  glGetFramebufferAttachmentParameteriv(
+    GL_FRAMEBUFFER, GL_DEPTH, GL_FRAMEBUFFER_ATTACHMENT_COMPONENT_TYPE, &depth_type);
+  const GLenum depth_format = oit_depth_format(depth_bits, stencil_bits, GL_FLOAT == depth_type);
+  if (GL_NONE == depth_format)
+  {
+    _oit.valid = false;
+    return false;
+  }
+
+  glBindRenderbuffer(GL_RENDERBUFFER, static_cast<GLuint>(_oit.depth));
+  glRenderbufferStorage(GL_RENDERBUFFER, depth_format, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(_oit.fbo));
+  glFramebufferTexture2D(
+    GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, static_cast<GLuint>(_oit.accum), 0);
+  glFramebufferTexture2D(
+    GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, static_cast<GLuint>(_oit.weight), 0);
+  const GLenum depth_attachment =
+    0 == stencil_bits ? GL_DEPTH_ATTACHMENT : GL_DEPTH_STENCIL_ATTACHMENT;
+  glFramebufferRenderbuffer(
+    GL_FRAMEBUFFER, depth_attachment, GL_RENDERBUFFER, static_cast<GLuint>(_oit.depth));
+  constexpr GLenum buffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+  glDrawBuffers(2, buffers);
+  _oit.valid = GL_FRAMEBUFFER_COMPLETE == glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return _oit.valid;
 }
 
 
 
-void Renderer::unset_light(const Light& light) const
+void Renderer::begin_oit()
 {
-  glDisable(static_cast<GLenum>(_lights[light.id]));
+  // transparent faces are depth tested against the opaque scene but do not write depth
+  const auto fbo = static_cast<GLuint>(_oit.fbo);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+  glBlitFramebuffer(
+    0, 0, _oit.width, _oit.height, 0, 0, _oit.width, _oit.height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+  // read in all builds so that the pending GL error does not depend on NDEBUG
+  [[maybe_unused]] const GLenum blit_error = glGetError();
+  assert(GL_NO_ERROR == blit_error && "opaque depth blit to the oit targets failed");
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+  // revealage starts at 1 (fully revealed), color and weight at 0
+  constexpr GLfloat accum[4] = {0, 0, 0, 1};
+  constexpr GLfloat weight[4] = {0, 0, 0, 0};
+  glClearBufferfv(GL_COLOR, 0, accum);
+  glClearBufferfv(GL_COLOR, 1, weight);
+
+  glDepthMask(GL_FALSE);
+  set_cap(Cap::blend, true);
+  glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+  _state.blend_src = -1;
+  _state.blend_dst = -1;
+
+  // glass parts are drawn by the instanced program with a constant identity instance transform
+  use_program(_oit_program);
+  glUniform1i(_oit_lights, lights_mask());
+  for (GLuint row = 0; row < 3; ++row)
+  {
+    glVertexAttrib4f(inst_mat_attrib + row, 0 == row, 1 == row, 2 == row, 0);
+  }
+  glVertexAttrib4f(inst_color_attrib, 1, 1, 1, 1);
+}
+
+
+
+void Renderer::end_oit()
+{
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDepthMask(GL_TRUE);
+
+  // blend the average transparent color over the opaque scene by the transparent coverage
+  use_program(_composite_program);
+  bind_vertex_array(0);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(_oit.weight));
+  glActiveTexture(GL_TEXTURE0);
+  bind_texture({.id = _oit.accum});
+  blend_func({.src = Blend::Src_alpha, .dst = Blend::One_minus_src_alpha});
+  // the real state is read when it is unknown, e.g. after invalidate_state, else it would be
+  // restored as disabled
+  const bool depth_test = (_state.known & (1u << Cap::depth_test))
+                          ? has_cap(Cap::depth_test)
+                          : GL_FALSE != glIsEnabled(GL_DEPTH_TEST);
+  set_cap(Cap::depth_test, false);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  set_cap(Cap::depth_test, depth_test);
+  ++_stats.draws;
+
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+
+
+void Renderer::check_state() const
+{
+#ifdef HERA_CHECK_GL_STATE
+  GLint value = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &value);
+  assert((-1 == _state.tex || value == _state.tex) && "bound texture changed outside renderer");
+  glGetIntegerv(GL_BLEND_SRC, &value);
+  assert((-1 == _state.blend_src || value == _state.blend_src) && "blend changed outside renderer");
+  glGetIntegerv(GL_BLEND_DST, &value);
+  assert((-1 == _state.blend_dst || value == _state.blend_dst) && "blend changed outside renderer");
+  glGetIntegerv(GL_MATRIX_MODE, &value);
+  assert(
+    (-1 == _state.matrix_mode || value == _state.matrix_mode) &&
+    "matrix mode changed outside renderer");
+  glGetIntegerv(GL_CURRENT_PROGRAM, &value);
+  assert((-1 == _state.program || value == _state.program) && "program changed outside renderer");
+  glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &value);
+  assert((-1 == _state.vao || value == _state.vao) && "vertex array changed outside renderer");
+  glGetIntegerv(GL_CULL_FACE_MODE, &value);
+  assert((-1 == _state.cull || value == _state.cull) && "cull face changed outside renderer");
+
+  for (int32_t cap = 0; cap < Cap::light0 + max_lights(); ++cap)
+  {
+    const uint32_t bit = 1u << cap;
+    const auto id =
+      static_cast<GLenum>(cap < Cap::light0 ? _caps[cap] : _lights[cap - Cap::light0]);
+    assert(
+      (!(_state.known & bit) || !!glIsEnabled(id) == !!(_state.enabled & bit)) &&
+      "capability changed outside renderer");
+  }
+#endif
 }
 
 } // namespace hera
@@ -269,26 +1021,313 @@ void Renderer::unset_light(const Light& light) const
 namespace
 {
 
-template <Part P, Face F>
-void render_face(const P& part, const F& face, std::span<const hera::Vertex> vertices)
+int8_t to_snorm8(float value)
 {
-  // save current matrix and set part matrix
-  glMatrixMode(GL_MODELVIEW);
-  glPushMatrix();
-  glMultMatrixd(part.mat.data);
+  return static_cast<int8_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 127));
+}
+
+
+
+uint16_t to_half(float value)
+{
+  const auto bits = std::bit_cast<uint32_t>(value);
+  const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+  const uint32_t abs = bits & 0x7fffffff;
+  if (abs >= 0x7f800000)
+  {
+    // infinity stays infinity, nan stays a quiet nan
+    return static_cast<uint16_t>(sign | (abs > 0x7f800000 ? 0x7e00 : 0x7c00));
+  }
+  if (abs >= 0x477ff000)
+  {
+    // 65520 and above round past the largest half
+    return static_cast<uint16_t>(sign | 0x7c00);
+  }
+  if (abs < 0x38800000)
+  {
+    // below the smallest normal half, subnormal in units of 2^-24
+    const float units = std::bit_cast<float>(abs) * 16777216.0f;
+    return static_cast<uint16_t>(sign | static_cast<uint32_t>(std::nearbyint(units)));
+  }
+
+  // rebias the exponent and round the mantissa from 23 to 10 bits, ties to even
+  const uint32_t rounded = abs + 0xfff + ((abs >> 13) & 1);
+  return static_cast<uint16_t>(sign | ((rounded - 0x38000000) >> 13));
+}
+
+
+
+GLenum oit_depth_format(GLint depth_bits, GLint stencil_bits, bool float_depth)
+{
+  if (0 == stencil_bits)
+  {
+    switch (depth_bits)
+    {
+      case 16:
+        return GL_DEPTH_COMPONENT16;
+      case 24:
+        return GL_DEPTH_COMPONENT24;
+      case 32:
+        return float_depth ? GL_DEPTH_COMPONENT32F : GL_DEPTH_COMPONENT32;
+      default:
+        return GL_NONE;
+    }
+  }
+  if (8 == stencil_bits)
+  {
+    switch (depth_bits)
+    {
+      case 24:
+        return GL_DEPTH24_STENCIL8;
+      case 32:
+        return float_depth ? GL_DEPTH32F_STENCIL8 : GL_NONE;
+      default:
+        return GL_NONE;
+    }
+  }
+  return GL_NONE;
+}
+
+
+
+template <Parts T>
+bool upload_parts(T& parts)
+{
+  auto& buffers = parts.buffers();
+  if (buffers.revision == parts.revision())
+  {
+    return false;
+  }
+
+  if (0 == buffers.vao)
+  {
+    GLuint vao = 0;
+    GLuint ids[2] = {0};
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(2, ids);
+    buffers.vao = static_cast<int32_t>(vao);
+    buffers.vbo = static_cast<int32_t>(ids[0]);
+    buffers.ibo = static_cast<int32_t>(ids[1]);
+
+    // the vertex array object records the attribute layout and the index buffer binding
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, ids[0]);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ids[1]);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    constexpr auto stride = static_cast<GLsizei>(sizeof(Gl_vertex));
+    glVertexPointer(3, GL_FLOAT, stride, reinterpret_cast<void*>(offsetof(Gl_vertex, pos)));
+    glNormalPointer(GL_BYTE, stride, reinterpret_cast<void*>(offsetof(Gl_vertex, norm)));
+    glTexCoordPointer(
+      2, GL_HALF_FLOAT, stride, reinterpret_cast<void*>(offsetof(Gl_vertex, tex)));
+    glColorPointer(
+      4, GL_UNSIGNED_BYTE, stride, reinterpret_cast<void*>(offsetof(Gl_vertex, color)));
+  }
+
+  const auto vertices = parts.vertices();
+  std::vector<Gl_vertex> data(vertices.size());
+  for (const auto& face : parts.faces())
+  {
+    const int8_t norm[4] = {
+      to_snorm8(face.norm.x), to_snorm8(face.norm.y), to_snorm8(face.norm.z), 0};
+    const auto vend = face.vbegin + 3 + face.is_quad;
+    for (auto i = face.vbegin; i < vend; ++i)
+    {
+      const auto& v = vertices[i];
+      data[i] = {
+        .pos =
+          {static_cast<float>(v.pos.x), static_cast<float>(v.pos.y), static_cast<float>(v.pos.z)},
+        .norm = {norm[0], norm[1], norm[2], norm[3]},
+        .tex = {to_half(static_cast<float>(v.tex.x)), to_half(static_cast<float>(v.tex.y))},
+        .color = {v.color.r, v.color.g, v.color.b, v.color.a}};
+    }
+  }
+
+  // faces share their identical corners after welding, so the vertex cache can reuse them
+  std::vector<Gl_vertex> unique;
+  std::vector<uint32_t> remap;
+  ares::weld<Gl_vertex>(data, unique, remap);
+  const auto parts_indices = parts.indices();
+  std::vector<uint32_t> indices(parts_indices.size());
+  for (size_t i = 0; i < indices.size(); ++i)
+  {
+    indices[i] = remap[parts_indices[i]];
+  }
+
+  // reorder the triangles inside each drawn range, glass faces are drawn in depth order by their
+  // own index ranges so their triangles keep their place
+  const auto triangles = std::max(static_cast<float>(indices.size() / 3), 1.0f);
+  buffers.acmr_before = static_cast<float>(ares::cache_misses(indices)) / triangles;
+  if constexpr (std::is_same_v<T, hera::Solid_parts>)
+  {
+    for (const auto& part : parts.parts())
+    {
+      ares::optimize_vertex_cache(
+        std::span<uint32_t>(indices).subspan(part.ibegin, part.icount));
+    }
+  }
+  else if constexpr (std::is_same_v<T, hera::Instanced_parts>)
+  {
+    ares::optimize_vertex_cache(indices);
+  }
+  buffers.acmr_after = static_cast<float>(ares::cache_misses(indices)) / triangles;
+  buffers.vertex_count = static_cast<int32_t>(unique.size());
+
+  glBindVertexArray(static_cast<GLuint>(buffers.vao));
+  glBindBuffer(GL_ARRAY_BUFFER, static_cast<GLuint>(buffers.vbo));
+  glBufferData(
+    GL_ARRAY_BUFFER,
+    static_cast<GLsizeiptr>(unique.size() * sizeof(Gl_vertex)),
+    unique.data(),
+    GL_STATIC_DRAW);
+  if (unique.size() <= 0x10000)
+  {
+    // 16 bit indices halve the index buffer and the index fetch bandwidth
+    const std::vector<uint16_t> short_indices(indices.begin(), indices.end());
+    glBufferData(
+      GL_ELEMENT_ARRAY_BUFFER,
+      static_cast<GLsizeiptr>(short_indices.size() * sizeof(uint16_t)),
+      short_indices.data(),
+      GL_STATIC_DRAW);
+    buffers.index_size = sizeof(uint16_t);
+  }
+  else
+  {
+    glBufferData(
+      GL_ELEMENT_ARRAY_BUFFER,
+      static_cast<GLsizeiptr>(indices.size() * sizeof(uint32_t)),
+      indices.data(),
+      GL_STATIC_DRAW);
+    buffers.index_size = sizeof(uint32_t);
+  }
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  buffers.revision = parts.revision();
+  return true;
+}
 
-  glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(part.tex.id));
 
-  // render face
-  glBegin(face.is_quad ? GL_QUADS : GL_TRIANGLES);
-  glNormal3f(face.norm.x, face.norm.y, face.norm.z);
-  for (const auto& v : vertices)
+
+bool upload_instances(hera::Instanced_parts& parts)
+{
+  const auto instances = parts.instances();
+  if (instances.empty() || parts.indices().empty())
+  {
+    return false;
+  }
+
+  upload_parts(parts);
+  auto& buffers = parts.buffers();
+  if (0 == buffers.inst)
+  {
+    GLuint inst = 0;
+    glGenBuffers(1, &inst);
+    buffers.inst = static_cast<int32_t>(inst);
+
+    // instance attributes advance once per instance instead of once per vertex
+    using Instance = hera::Instanced_parts::Instance;
+    constexpr auto stride = static_cast<GLsizei>(sizeof(Instance));
+    glBindVertexArray(static_cast<GLuint>(buffers.vao));
+    glBindBuffer(GL_ARRAY_BUFFER, inst);
+    for (GLuint row = 0; row < 3; ++row)
+    {
+      const auto offset = offsetof(Instance, mat) + row * 4 * sizeof(float);
+      glEnableVertexAttribArray(hera::inst_mat_attrib + row);
+      glVertexAttribPointer(
+        hera::inst_mat_attrib + row,
+        4,
+        GL_FLOAT,
+        GL_FALSE,
+        stride,
+        reinterpret_cast<void*>(offset));
+      glVertexAttribDivisor(hera::inst_mat_attrib + row, 1);
+    }
+    glEnableVertexAttribArray(hera::inst_color_attrib);
+    glVertexAttribPointer(
+      hera::inst_color_attrib,
+      4,
+      GL_UNSIGNED_BYTE,
+      GL_TRUE,
+      stride,
+      reinterpret_cast<void*>(offsetof(Instance, color)));
+    glVertexAttribDivisor(hera::inst_color_attrib, 1);
+  }
+
+  // orphan the previous frame storage so the driver does not wait for pending draws
+  glBindBuffer(GL_ARRAY_BUFFER, static_cast<GLuint>(buffers.inst));
+  glBufferData(GL_ARRAY_BUFFER, instances.size_bytes(), nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size_bytes(), instances.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+  return true;
+}
+
+
+
+void render_instances(
+  const hera::Instanced_parts& parts, const hera::Buffers& buffers, GLint textured_loc)
+{
+  const auto instances = parts.instances();
+  if (instances.empty() || parts.indices().empty())
   {
-    glTexCoord2d(v.tex.x, v.tex.y);
-    glColor4ub(v.color.r, v.color.g, v.color.b, v.color.a);
-    glVertex3d(v.pos.x, v.pos.y, v.pos.z);
+    return;
   }
-  glEnd();
+
+  glUniform1i(textured_loc, 0 != parts.texture().id);
+  glDrawElementsInstanced(
+    GL_TRIANGLES,
+    static_cast<GLsizei>(parts.indices().size()),
+    index_type(buffers),
+    nullptr,
+    static_cast<GLsizei>(instances.size()));
+}
+
+
+
+GLenum index_type(const hera::Buffers& buffers)
+{
+  return 2 == buffers.index_size ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+
+
+template <Part P>
+void render_range(const P& part, const hera::Buffers& buffers, int32_t ibegin, int32_t icount)
+{
+  // save current matrix and set part matrix, the modelview matrix is selected by the renderer
+  glPushMatrix();
+  glMultMatrixd(part.mat.data);
+
+  // render all triangles in the range
+  const auto offset = static_cast<size_t>(ibegin) * buffers.index_size;
+  glDrawElements(GL_TRIANGLES, icount, index_type(buffers), reinterpret_cast<void*>(offset));
+
+  // restore original matrix
+  glPopMatrix();
+}
+
+
+
+template <Part P>
+void render_ranges(
+  const P& part,
+  const hera::Buffers& buffers,
+  std::span<const int32_t> counts,
+  std::span<const void* const> offsets)
+{
+  // save current matrix and set part matrix, the modelview matrix is selected by the renderer
+  glPushMatrix();
+  glMultMatrixd(part.mat.data);
+
+  // render all ranges with a single call
+  glMultiDrawElements(
+    GL_TRIANGLES,
+    counts.data(),
+    index_type(buffers),
+    offsets.data(),
+    static_cast<GLsizei>(counts.size()));
 
   // restore original matrix
   glPopMatrix();
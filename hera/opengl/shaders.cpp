@@ -0,0 +1,80 @@
+#include "shaders.h"
+
+namespace
+{
+
+/**
+ * @brief Compile a shader
+ * @param type Shader type
+ * @param src Shader source
+ * @return Shader id, 0 if compilation failed
+ */
+GLuint compile_shader(GLenum type, const char* src);
+
+} // namespace
+
+namespace hera
+{
+
+GLuint make_program(
+  const char* vs,
+  const char* fs,
+  std::initializer_list<std::pair<GLuint, const char*>> attribs,
+  std::initializer_list<std::pair<GLuint, const char*>> outputs)
+{
+  const GLuint vshader = compile_shader(GL_VERTEX_SHADER, vs);
+  const GLuint fshader = compile_shader(GL_FRAGMENT_SHADER, fs);
+  GLuint program = 0;
+
+  if (0 != vshader && 0 != fshader)
+  {
+    program = glCreateProgram();
+    glAttachShader(program, vshader);
+    glAttachShader(program, fshader);
+    for (const auto& [location, name] : attribs)
+    {
+      glBindAttribLocation(program, location, name);
+    }
+    for (const auto& [location, name] : outputs)
+    {
+      glBindFragDataLocation(program, location, name);
+    }
+    glLinkProgram(program);
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (GL_TRUE != linked)
+    {
+      glDeleteProgram(program);
+      program = 0;
+    }
+  }
+
+  // shaders are kept alive by the program, flagging them for deletion is enough
+  glDeleteShader(vshader);
+  glDeleteShader(fshader);
+  return program;
+}
+
+} // namespace hera
+
+namespace
+{
+
+GLuint compile_shader(GLenum type, const char* src)
+{
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &src, nullptr);
+  glCompileShader(shader);
+
+  GLint compiled = GL_FALSE;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+  if (GL_TRUE != compiled)
+  {
+    glDeleteShader(shader);
+    shader = 0;
+  }
+  return shader;
+}
+
+} // namespace
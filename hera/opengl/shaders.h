@@ -0,0 +1,141 @@
+#ifndef __HERA_SHADERS_H__
+#define __HERA_SHADERS_H__
+
+#include "heragl.h"
+
+#include <initializer_list>
+#include <utility>
+
+namespace hera
+{
+
+// first of the 3 consecutive attribute locations holding the instance transform rows, chosen past
+// the locations some drivers alias with the fixed function attributes
+constexpr GLuint inst_mat_attrib = 9;
+// attribute location of the instance color
+constexpr GLuint inst_color_attrib = 12;
+
+// instanced parts vertex shader, transforms by the instance affine transform rows then by the fixed
+// function matrices and applies the enabled fixed function lights (ambient and diffuse only). Also
+// used for non instanced parts by setting constant instance attributes (identity rows, white color)
+constexpr const char* instanced_vs = R"(
+#version 130
+in vec4 inst_row0;
+in vec4 inst_row1;
+in vec4 inst_row2;
+in vec4 inst_color;
+uniform int lights;
+out vec4 color;
+out vec2 tex;
+
+void main()
+{
+  vec4 world_pos = vec4(
+    dot(inst_row0, gl_Vertex), dot(inst_row1, gl_Vertex), dot(inst_row2, gl_Vertex), 1.0);
+  vec4 eye_pos = gl_ModelViewMatrix * world_pos;
+  gl_Position = gl_ProjectionMatrix * eye_pos;
+  tex = gl_MultiTexCoord0.xy;
+  color = gl_Color * inst_color;
+
+  if (0 != lights)
+  {
+    mat3 model = transpose(mat3(inst_row0.xyz, inst_row1.xyz, inst_row2.xyz));
+    vec3 norm = normalize(mat3(gl_ModelViewMatrix) * model * gl_Normal);
+    vec3 lit = gl_LightModel.ambient.rgb * color.rgb;
+    for (int i = 0; i < 8; ++i)
+    {
+      if (0 != (lights & (1 << i)))
+      {
+        vec4 pos = gl_LightSource[i].position;
+        vec3 dir = normalize(pos.xyz - eye_pos.xyz * pos.w);
+        float diffuse = max(dot(norm, dir), 0.0);
+        lit += gl_LightSource[i].ambient.rgb * color.rgb;
+        lit += gl_LightSource[i].diffuse.rgb * diffuse * color.rgb;
+      }
+    }
+    color = vec4(min(lit, 1.0), color.a);
+  }
+}
+)";
+
+// instanced parts fragment shader, modulates the vertex color with the texture if any
+constexpr const char* instanced_fs = R"(
+#version 130
+uniform sampler2D tex_unit;
+uniform bool textured;
+in vec4 color;
+in vec2 tex;
+
+void main()
+{
+  gl_FragColor = textured ? color * texture(tex_unit, tex) : color;
+}
+)";
+
+// weighted blended transparency fragment shader, accumulates the weighted premultiplied color
+// and the revealage in the first target and the weighted alpha in the second target. Blending
+// must be one, one for color and zero, one minus src alpha for alpha. Weight from McGuire and
+// Bavoil, "Weighted Blended Order-Independent Transparency", equation 7
+constexpr const char* oit_fs = R"(
+#version 130
+uniform sampler2D tex_unit;
+uniform bool textured;
+in vec4 color;
+in vec2 tex;
+out vec4 accum;
+out vec4 weight;
+
+void main()
+{
+  vec4 frag = textured ? color * texture(tex_unit, tex) : color;
+  float z = 1.0 - gl_FragCoord.z;
+  float w = frag.a * max(1e-2, 3e3 * z * z * z);
+  accum = vec4(frag.rgb * frag.a * w, frag.a);
+  weight = vec4(frag.a * w);
+}
+)";
+
+// weighted blended transparency composite vertex shader, a triangle covering the viewport
+constexpr const char* composite_vs = R"(
+#version 130
+
+void main()
+{
+  vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+  gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+// weighted blended transparency composite fragment shader, outputs the average transparent color
+// with the coverage as alpha, to be blended with src alpha, one minus src alpha
+constexpr const char* composite_fs = R"(
+#version 130
+uniform sampler2D accum_unit;
+uniform sampler2D weight_unit;
+
+void main()
+{
+  ivec2 pos = ivec2(gl_FragCoord.xy);
+  vec4 accum = texelFetch(accum_unit, pos, 0);
+  float weight = texelFetch(weight_unit, pos, 0).r;
+  gl_FragColor = vec4(accum.rgb / max(weight, 1e-5), 1.0 - accum.a);
+}
+)";
+
+/**
+ * @brief Compile and link a shader program
+ * @param vs Vertex shader source
+ * @param fs Fragment shader source
+ * @param attribs Attribute locations to bind before linking
+ * @param outputs Fragment output locations to bind before linking
+ * @return Program id, 0 if compilation or linking failed
+ */
+GLuint make_program(
+  const char* vs,
+  const char* fs,
+  std::initializer_list<std::pair<GLuint, const char*>> attribs,
+  std::initializer_list<std::pair<GLuint, const char*>> outputs = {});
+
+} // namespace hera
+
+#endif //__HERA_SHADERS_H__
@@ -14,9 +14,9 @@
 #define CALLBACK __stdcall
 #endif
 
+// extensions loader, must be included before the gl headers
+#include <GL/glew.h>
 #include <gl/GL.h>
 #include <gl/GLU.h>
 
-// TODO extensions
-
 #endif //__WINGL_H__
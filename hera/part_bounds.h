@@ -0,0 +1,125 @@
+#ifndef __HERA_PART_BOUNDS_H__
+#define __HERA_PART_BOUNDS_H__
+
+#include <ares/bbox3.h>
+#include <ares/bbox3_soa.h>
+#include <span>
+#include <vector>
+
+namespace hera
+{
+
+/**
+ * @brief World cs bounding boxes of a parts collection, recomputed lazily from the parts local cs
+ * bounding boxes and matrices, only for the parts that changed since the last update
+ */
+class Part_bounds
+{
+public:
+
+  /**
+   * @brief Add the bounds of a new part, computed on the next update
+   */
+  void add_part();
+
+  /**
+   * @brief Mark a part as changed so that its world cs bounding box is computed on the next update,
+   * call when the part matrix or local cs bounding box change
+   * @param part Part index
+   */
+  void mark_changed(int32_t part);
+
+  /**
+   * @brief Update the world cs bounding boxes of the changed parts
+   * @tparam P Part type with a local cs bounding box and a matrix from local cs
+   * @param parts All parts, in the order they were added
+   * @return World cs bounding boxes, one per part, empty for parts without faces
+   */
+  template <typename P>
+  const ares::Bbox3_soa& update(std::span<const P> parts);
+
+  /**
+   * @brief Update the world cs bounding boxes of the changed parts
+   * @tparam P Part type with a local cs bounding box and a matrix from local cs
+   * @tparam F Callback type
+   * @param parts All parts, in the order they were added
+   * @param updated Called with the index and new world cs bounding box of each updated part
+   * @return World cs bounding boxes, one per part, empty for parts without faces
+   */
+  template <typename P, typename F>
+  const ares::Bbox3_soa& update(std::span<const P> parts, F&& updated);
+
+  /**
+   * @brief Get the per part frustum culling state, see ares::cull with a frustum
+   * @return Index of the frustum plane that last rejected each part
+   */
+  std::span<uint8_t> rejecting_planes();
+
+private:
+
+  // world cs bounding boxes
+  ares::Bbox3_soa _world;
+  // changed parts waiting for an update
+  std::vector<int32_t> _changed;
+  // per part flag set while the part is in the changed list
+  std::vector<uint8_t> _is_changed;
+  // per part index of the frustum plane that last rejected it
+  std::vector<uint8_t> _rejecting;
+};
+
+
+
+inline void Part_bounds::add_part()
+{
+  _world.push_back({});
+  _is_changed.push_back(0);
+  _rejecting.push_back(0);
+  mark_changed(static_cast<int32_t>(_is_changed.size()) - 1);
+}
+
+
+
+inline void Part_bounds::mark_changed(int32_t part)
+{
+  if (0 == _is_changed[part])
+  {
+    _is_changed[part] = 1;
+    _changed.push_back(part);
+  }
+}
+
+
+
+template <typename P>
+const ares::Bbox3_soa& Part_bounds::update(std::span<const P> parts)
+{
+  return update(parts, [](int32_t, const ares::Bbox3&) {});
+}
+
+
+
+template <typename P, typename F>
+const ares::Bbox3_soa& Part_bounds::update(std::span<const P> parts, F&& updated)
+{
+  for (const auto index : _changed)
+  {
+    const auto& part = parts[index];
+    const auto box = part.bbox.transformed(part.mat);
+    _world.set(index, box);
+    _is_changed[index] = 0;
+    updated(index, box);
+  }
+  _changed.clear();
+  return _world;
+}
+
+
+
+inline std::span<uint8_t> Part_bounds::rejecting_planes()
+{
+  return _rejecting;
+}
+
+} // namespace hera
+
+#endif //__HERA_PART_BOUNDS_H__
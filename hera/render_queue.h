@@ -0,0 +1,174 @@
+#ifndef __HERA_RENDER_QUEUE_H__
+#define __HERA_RENDER_QUEUE_H__
+
+#include "blend.h"
+
+#include <algorithm>
+#include <ares/radix_sort.h>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace hera
+{
+
+/**
+ * @brief Per frame draw queue, draws are ordered by a packed 64 bit sort key so that state changes
+ * (pass, blend, texture) are grouped together. Key bits, most significant first:
+ * opaque: pass (2) | blend src (3) | blend dst (3) | texture (24) | depth (24) | unused (8)
+ * glass: pass (2) | depth order (24) | blend src (3) | blend dst (3) | texture (24) | unused (8)
+ * Glass draws must stay in back to front order, so for them depth comes before the state bits
+ */
+class Render_queue
+{
+public:
+
+  // render pass, the most significant key bits
+  enum Pass
+  {
+    Solid = 0,
+    Instanced,
+    Glass
+  };
+
+  struct Draw
+  {
+    // sort key
+    uint64_t key{0};
+    // item index in the pass collection (part, instanced parts or face index)
+    int32_t item{0};
+  };
+
+  /**
+   * @brief Make the sort key of an opaque draw
+   * @param pass Render pass
+   * @param tex Texture id
+   * @param depth Depth bucket, see depth_bucket
+   * @return Sort key
+   */
+  static constexpr uint64_t opaque_key(Pass pass, int32_t tex, uint32_t depth);
+
+  /**
+   * @brief Make the sort key of a glass (transparent) draw
+   * @param order Position in the back to front order
+   * @param blend Blend parameters
+   * @param tex Texture id
+   * @return Sort key
+   */
+  static constexpr uint64_t glass_key(uint32_t order, Blend blend, int32_t tex);
+
+  /**
+   * @brief Quantize a view depth to a depth bucket, closer depths have lower buckets
+   * @param depth View depth
+   * @param near Near clipping distance
+   * @param far Far clipping distance
+   * @return Depth bucket
+   */
+  static constexpr uint32_t depth_bucket(double depth, double near, double far);
+
+  /**
+   * @brief Get the render pass of a sort key
+   * @param key Sort key
+   * @return Render pass
+   */
+  static constexpr Pass pass(uint64_t key);
+
+  /**
+   * @brief Remove all draws
+   */
+  void clear();
+
+  /**
+   * @brief Add a draw
+   * @param key Sort key
+   * @param item Item index in the pass collection
+   */
+  void add(uint64_t key, int32_t item);
+
+  /**
+   * @brief Sort draws by key (radix sort, stable)
+   */
+  void sort();
+
+  /**
+   * @brief Get the draws
+   * @return Draws
+   */
+  std::span<const Draw> draws() const;
+
+private:
+
+  // bits used by the texture id and depth fields
+  static constexpr int field_bits = 24;
+  // mask of the texture id and depth fields
+  static constexpr uint64_t field_mask = (uint64_t{1} << field_bits) - 1;
+
+  // queued draws
+  std::vector<Draw> _draws;
+  // sort scratch buffer
+  std::vector<Draw> _scratch;
+};
+
+
+
+inline constexpr uint64_t Render_queue::opaque_key(Pass pass, int32_t tex, uint32_t depth)
+{
+  return uint64_t{pass} << 62 | (static_cast<uint64_t>(tex) & field_mask) << 32
+       | (depth & field_mask) << 8;
+}
+
+
+
+inline constexpr uint64_t Render_queue::glass_key(uint32_t order, Blend blend, int32_t tex)
+{
+  return uint64_t{Pass::Glass} << 62 | (order & field_mask) << 38
+       | static_cast<uint64_t>(blend.src) << 35 | static_cast<uint64_t>(blend.dst) << 32
+       | (static_cast<uint64_t>(tex) & field_mask) << 8;
+}
+
+
+
+inline constexpr uint32_t Render_queue::depth_bucket(double depth, double near, double far)
+{
+  const double ratio = std::clamp((depth - near) / (far - near), 0.0, 1.0);
+  return static_cast<uint32_t>(ratio * field_mask);
+}
+
+
+
+inline constexpr Render_queue::Pass Render_queue::pass(uint64_t key)
+{
+  return static_cast<Pass>(key >> 62);
+}
+
+
+
+inline void Render_queue::clear()
+{
+  _draws.clear();
+}
+
+
+
+inline void Render_queue::add(uint64_t key, int32_t item)
+{
+  _draws.push_back({.key = key, .item = item});
+}
+
+
+
+inline void Render_queue::sort()
+{
+  ares::radix_sort(_draws, _scratch, [](const Draw& draw) { return draw.key; });
+}
+
+
+
+inline std::span<const Render_queue::Draw> Render_queue::draws() const
+{
+  return _draws;
+}
+
+} // namespace hera
+
+#endif //__HERA_RENDER_QUEUE_H__
@@ -1,38 +1,78 @@
 #ifndef __HERA_RENDERER_H__
 #define __HERA_RENDERER_H__
 
+#include "blend.h"
+#include "render_queue.h"
 #include "texture.h"
 
+#include <ares/cull.h>
+#include <ares/frustum.h>
 #include <ares/matrix.h>
 #include <ares/vec3.h>
 #include <array>
+#include <span>
+#include <vector>
 
 namespace hera
 {
 
 class Image;
 class Glass_parts;
+class Instanced_parts;
 class Solid_parts;
 struct Light;
 
+struct Render_stats
+{
+  // draw calls issued
+  int32_t draws{0};
+  // solid and glass parts skipped because they are outside of the view frustum
+  int32_t culled{0};
+  // glass parts classified one by one against the view frustum
+  int32_t cull_tested{0};
+  // view frustum plane tests of these parts, divided by cull_tested gives the average per part
+  int32_t plane_tests{0};
+  // sorted glass faces merged into the draw of the previous face of the same part
+  int32_t merged_draws{0};
+  // texture binds issued
+  int32_t texture_binds{0};
+  // texture binds skipped because the texture was already bound
+  int32_t texture_binds_avoided{0};
+  // blend function changes issued
+  int32_t blend_changes{0};
+  // blend function changes skipped because the factors were already set
+  int32_t blend_changes_avoided{0};
+  // capability, matrix mode, program and vertex array changes issued
+  int32_t state_changes{0};
+  // capability, matrix mode, program and vertex array changes skipped because already set
+  int32_t state_changes_avoided{0};
+};
+
 class Renderer
 {
 public:
 
+  // glass (transparent) parts rendering method
+  enum class Transparency
+  {
+    Sorted,      // faces drawn one by one in the glass parts sorted order
+    Weighted_oit // weighted blended order independent transparency, parts drawn unsorted
+  };
+
   /**
    * @brief Construct a new object
    */
   Renderer();
 
   /**
-   * @brief Basic scene setup
+   * @brief Basic scene setup, also creates the shader programs
    */
-  void basic_scene_setup() const;
+  void basic_scene_setup();
 
   /**
    * @brief Basic start scene setup, clears buffers, loads identity
    */
-  void basic_start_scene() const;
+  void basic_start_scene();
 
   /**
    * @brief Set viewport
@@ -51,7 +91,7 @@ public:
    * @param znear Near clipping plane z distance
    * @param zfar Far clipping plane z distance
    */
-  void set_perspective(bool push_mvp, double fov, double aspect, double znear, double zfar) const;
+  void set_perspective(bool push_mvp, double fov, double aspect, double znear, double zfar);
 
   /**
    * @brief Map window coordinates to object coordinates
@@ -63,12 +103,25 @@ public:
   const ares::dvec3 un_project(double winx, double winy, double winz = 1) const;
 
   /**
-   * @brief Define a view transform setting the "camera" eye position looking at center position
+   * @brief Define a view transform setting the "camera" eye position looking at center position,
+   * the eye and view direction are also used to order draws by depth
    * @param eye Position of the eye
    * @param center Position of the look at point
    * @param up Camera up
    */
-  void look_at(const ares::dvec3& eye, const ares::dvec3& center, const ares::dvec3& up) const;
+  void look_at(const ares::dvec3& eye, const ares::dvec3& center, const ares::dvec3& up);
+
+  /**
+   * @brief Set the view frustum, solid and glass parts outside of it are not rendered
+   * @param frustum View frustum
+   */
+  void set_frustum(const ares::Frustum& frustum);
+
+  /**
+   * @brief Use view frustum culling, enabled by default once a frustum is set
+   * @param enable Enable/disable culling
+   */
+  void use_culling(bool enable);
 
   /**
    * @brief Create a texture from image
@@ -77,15 +130,60 @@ public:
    * @param mag Magnification filter
    * @return Created texture
    */
-  Texture create_texture(const Image& img, Texture::Min min, Texture::Mag mag) const;
+  Texture create_texture(const Image& img, Texture::Min min, Texture::Mag mag);
+
+  /**
+   * @brief Bind texture unless it is already bound
+   * @param tex Texture to bind, 0 id unbinds
+   */
+  void bind_texture(Texture tex);
 
   /**
-   * @brief Render the provided parts, solids (opaque) first then aquas (transparents)
+   * @brief Forget the tracked GL state, call after changing GL state outside of the renderer so
+   * that the next renderer calls are issued again
+   */
+  void invalidate_state();
+
+  /**
+   * @brief Render the provided parts, solids (opaque) first then aquas (transparents). Parts
+   * vertices are uploaded to render buffers on first use and again only when faces are added
    * @param solids Solid (opaque) parts
    * @param glassy Glassy (transparent) parts, must be sorted farthest to closest relative to the
    * viewer
    */
-  void render_parts(const Solid_parts& solids, const Glass_parts& glassy);
+  void render_parts(Solid_parts& solids, Glass_parts& glassy);
+
+  /**
+   * @brief Render the provided parts, solids (opaque) and instanced solids first then aquas
+   * (transparents). Instanced parts are drawn with one instanced call each, their instance data is
+   * streamed every frame. Draws go through a render queue sorted by state, solids are also sorted
+   * front to back
+   * @param solids Solid (opaque) parts
+   * @param instanced Instanced solid (opaque) parts
+   * @param glassy Glassy (transparent) parts, must be sorted farthest to closest relative to the
+   * viewer
+   */
+  void render_parts(Solid_parts& solids, std::span<Instanced_parts> instanced, Glass_parts& glassy);
+
+  /**
+   * @brief Set the glass parts rendering method. Weighted blended transparency draws each part with
+   * one call and ignores the parts blend params, src alpha and one minus src alpha is used. It
+   * falls back to sorted when its shader programs or render targets are not supported
+   * @param mode Rendering method
+   */
+  void set_transparency(Transparency mode);
+
+  /**
+   * @brief Get the glass parts rendering method
+   * @return Rendering method
+   */
+  Transparency transparency() const;
+
+  /**
+   * @brief Get the statistics of the last render_parts call
+   * @return Render statistics
+   */
+  const Render_stats& stats() const;
 
   /**
    * @brief Get the max number of supported lights
@@ -97,7 +195,7 @@ public:
    * @brief Use lighting model
    * @param enable Enable/disable lighting model
    */
-  void use_lighting(bool enable) const;
+  void use_lighting(bool enable);
 
   /**
    * @brief Add a new light, upt to max lights after which overwrite last added light
@@ -110,13 +208,13 @@ public:
    * @brief Set the provided light
    * @param light Light to set
    */
-  void set_light(const Light& light) const;
+  void set_light(const Light& light);
 
   /**
    * @brief Unset the provided light
    * @param light Light to unset
    */
-  void unset_light(const Light& light) const;
+  void unset_light(const Light& light);
 
   // enum used to access viewport attributes
   enum Vp
@@ -129,6 +227,136 @@ public:
 
 private:
 
+  // enum used to access the tracked capabilities, lights follow light0 in order
+  enum Cap
+  {
+    blend = 0,      // blending
+    lighting,       // fixed function lighting
+    color_material, // material tracks the vertex color
+    texture_2d,     // 2D texturing
+    depth_test,     // depth testing
+    offset_fill,    // polygon offset for filled polygons
+    culling,        // face culling
+    light0          // first light
+  };
+
+  // weighted blended transparency render targets
+  struct Oit_targets
+  {
+    // framebuffer
+    int32_t fbo{0};
+    // accumulated color and revealage texture
+    int32_t accum{0};
+    // accumulated weight texture
+    int32_t weight{0};
+    // depth renderbuffer, holds a copy of the opaque depth
+    int32_t depth{0};
+    // targets width
+    int32_t width{0};
+    // targets height
+    int32_t height{0};
+    // targets are complete and usable
+    bool valid{false};
+  };
+
+  // shadow copy of the GL state set through the renderer, used to drop redundant calls
+  struct Gl_state
+  {
+    // bound texture, -1 if unknown
+    int32_t tex{-1};
+    // blend source factor, -1 if unknown
+    int32_t blend_src{-1};
+    // blend destination factor, -1 if unknown
+    int32_t blend_dst{-1};
+    // matrix mode, -1 if unknown
+    int32_t matrix_mode{-1};
+    // used program, -1 if unknown
+    int32_t program{-1};
+    // bound vertex array, -1 if unknown
+    int32_t vao{-1};
+    // culled faces, -1 if unknown
+    int32_t cull{-1};
+    // capabilities with a known state, one bit per Cap
+    uint32_t known{0};
+    // enabled capabilities, one bit per Cap
+    uint32_t enabled{0};
+  };
+
+  /**
+   * @brief Set the blend function unless it is already set
+   * @param blend Blend parameters
+   */
+  void blend_func(Blend blend);
+
+  /**
+   * @brief Enable or disable a capability unless it is already in the requested state
+   * @param cap Capability to change
+   * @param enable Enable/disable the capability
+   */
+  void set_cap(int32_t cap, bool enable);
+
+  /**
+   * @brief Check if a capability has been enabled through the renderer
+   * @param cap Capability to check
+   * @return True if enabled, false if disabled or unknown
+   */
+  bool has_cap(int32_t cap) const;
+
+  /**
+   * @brief Select the matrix stack unless it is already selected
+   * @param mode Matrix mode
+   */
+  void matrix_mode(int32_t mode);
+
+  /**
+   * @brief Select the culled faces unless they are already selected
+   * @param mode Culled faces
+   */
+  void cull_face(int32_t mode);
+
+  /**
+   * @brief Use the shader program unless it is already used
+   * @param id Program id, 0 for the fixed function pipeline
+   */
+  void use_program(int32_t id);
+
+  /**
+   * @brief Bind the vertex array unless it is already bound
+   * @param id Vertex array id
+   */
+  void bind_vertex_array(int32_t id);
+
+  /**
+   * @brief Get the enabled lights as a mask for the shader programs
+   * @return Enabled lights mask, 0 if lighting is disabled
+   */
+  int32_t lights_mask() const;
+
+  /**
+   * @brief Create or resize the weighted blended transparency render targets to the viewport
+   * @return True if the targets and programs are usable
+   */
+  bool prepare_oit();
+
+  /**
+   * @brief Start the weighted blended transparency pass, copies the opaque depth and redirects
+   * rendering to the transparency targets
+   */
+  void begin_oit();
+
+  /**
+   * @brief End the weighted blended transparency pass, composites the accumulated transparency
+   * over the opaque scene
+   */
+  void end_oit();
+
+  /**
+   * @brief Compare the tracked GL state with the actual GL state, only done when built with
+   * HERA_CHECK_GL_STATE, a mismatch means GL state was changed outside of the renderer without
+   * calling invalidate_state
+   */
+  void check_state() const;
+
   // Viewport position and size (x, y, width, height)
   int32_t _viewport[4] = {0};
   // Cached matrix used in various computations
@@ -141,8 +369,56 @@ private:
   std::array<int32_t, 5> _blend;
   // lights enum
   std::array<int32_t, 8> _lights;
+  // capabilities enum, up to light0
+  std::array<int32_t, Cap::light0> _caps;
   // number of added lights
   int32_t _light_count{0};
+  // instanced parts shader program
+  int32_t _inst_program{0};
+  // instanced parts texture enabled uniform location
+  int32_t _inst_textured{-1};
+  // instanced parts enabled lights mask uniform location
+  int32_t _inst_lights{-1};
+  // glass parts rendering method
+  Transparency _transparency{Transparency::Sorted};
+  // weighted blended transparency shader program
+  int32_t _oit_program{0};
+  // weighted blended transparency texture enabled uniform location
+  int32_t _oit_textured{-1};
+  // weighted blended transparency enabled lights mask uniform location
+  int32_t _oit_lights{-1};
+  // weighted blended transparency composite shader program
+  int32_t _composite_program{0};
+  // weighted blended transparency render targets
+  Oit_targets _oit;
+  // view eye position
+  ares::dvec3 _eye;
+  // view direction, normalized
+  ares::dvec3 _view_dir{.z = -1};
+  // near clipping distance
+  double _znear{0.1};
+  // far clipping distance
+  double _zfar{100};
+  // per frame draw queue
+  Render_queue _queue;
+  // view frustum
+  ares::Frustum _frustum;
+  // a view frustum has been set
+  bool _has_frustum{false};
+  // view frustum culling is enabled
+  bool _culling{true};
+  // solid parts visibility in the view frustum
+  std::vector<ares::Visibility> _solids_visibility;
+  // glass parts visibility in the view frustum
+  std::vector<ares::Visibility> _glass_visibility;
+  // index counts of the merged glass face ranges
+  std::vector<int32_t> _counts;
+  // index buffer offsets of the merged glass face ranges
+  std::vector<const void*> _offsets;
+  // last render_parts statistics
+  Render_stats _stats;
+  // tracked GL state
+  Gl_state _state;
 };
 
 } // namespace hera
@@ -1,9 +1,14 @@
 #ifndef __HERA_SOLID_PARTS_H__
 #define __HERA_SOLID_PARTS_H__
 
+#include "buffers.h"
+#include "part_bounds.h"
 #include "texture.h"
 #include "vertex.h"
 
+#include <ares/bbox3.h>
+#include <ares/bvh.h>
+#include <ares/dynamic_tree.h>
 #include <ares/matrix.h>
 #include <span>
 #include <vector>
@@ -22,8 +27,21 @@ public:
   {
     // texture
     Texture tex;
-    // matrix from object local cs
+    // matrix from object local cs, use set_matrix or set_origin to change it
     ares::dmatrix mat;
+    // first face index, part faces are contiguous
+    int32_t fbegin{0};
+    // number of faces
+    int32_t fcount{0};
+    // first index, part indices are contiguous
+    int32_t ibegin{0};
+    // number of indices
+    int32_t icount{0};
+    // bounding box in local cs
+    ares::Bbox3 bbox;
+    // part is moved after being added and culled through the movable parts tree, else it is
+    // static and culled through the static parts hierarchy
+    bool movable{false};
   };
 
   struct Face
@@ -36,14 +54,18 @@ public:
     bool is_quad{false};
     // vertex begin index
     int32_t vbegin{0};
+    // index begin index, faces are triangulated, 3 indices for triangles and 6 for quads
+    int32_t ibegin{0};
   };
 
   /**
    * @brief Add part
    * @param tex Part texture
    * @param cs Local cs
+   * @param movable Part is moved after being added, static parts can be moved too but each move
+   * rebuilds the static parts hierarchy
    */
-  void add_part(Texture tex, const ares::dcs3& cs);
+  void add_part(Texture tex, const ares::dcs3& cs, bool movable = false);
 
   /**
    * @brief Add a face for the last added part
@@ -70,42 +92,163 @@ public:
     const Vertex& v3);
 
   /**
-   * @brief Get the part at the provided index
-   * @param index Index to use
-   * @return Requested part
+   * @brief Set the matrix of a part, its world cs bounding box is updated on the next request
+   * @param part Part index
+   * @param mat Matrix from object local cs
    */
-  Part& get_part(int index);
+  void set_matrix(int32_t part, const ares::dmatrix& mat);
 
-  // Part const iterator
-  struct Citer;
+  /**
+   * @brief Set the matrix origin of a part, its world cs bounding box is updated on the next
+   * request
+   * @param part Part index
+   * @param origin Origin in world cs
+   */
+  void set_origin(int32_t part, const ares::dvec3& origin);
 
   /**
-   * @brief Returns an iterator to the beginning of all faces
+   * @brief Get all parts
+   * @return Parts
+   */
+  std::span<const Part> parts() const;
+
+  /**
+   * @brief Get the world cs bounding boxes of all parts, the boxes of parts that changed since the
+   * last request are updated first
+   * @return Bounding boxes, one per part
+   */
+  const ares::Bbox3_soa& world_boxes();
+
+  /**
+   * @brief Get the indices of the static parts, in the order they were added
+   * @return Part indices
+   */
+  std::span<const int32_t> static_parts() const;
+
+  /**
+   * @brief Get the indices of the movable parts, in the order they were added
+   * @return Part indices
+   */
+  std::span<const int32_t> movable_parts() const;
+
+  /**
+   * @brief Get the bounding volume hierarchy of the static parts world cs bounding boxes, rebuilt
+   * first if static parts changed since the last request
+   * @return Hierarchy, primitive i is the static part at index i in static_parts
+   */
+  const ares::Bvh& static_bvh();
+
+  /**
+   * @brief Get the dynamic tree of the movable parts fattened world cs bounding boxes, the boxes
+   * of movable parts that changed since the last request are moved in the tree first
+   * @return Tree, the proxies user data is the part index
+   */
+  const ares::Dynamic_tree& movable_tree();
+
+  /**
+   * @brief Get all faces
+   * @return Faces
+   */
+  std::span<const Face> faces() const;
+
+  /**
+   * @brief Get all vertices
+   * @return Vertices
+   */
+  std::span<const Vertex> vertices() const;
+
+  /**
+   * @brief Get all triangle indices
+   * @return Indices
+   */
+  std::span<const uint32_t> indices() const;
+
+  /**
+   * @brief Get the vertex data revision, incremented each time a face is added
+   * @return Revision
+   */
+  int32_t revision() const;
+
+  /**
+   * @brief Get the render buffers holding the uploaded vertex data
+   * @return Render buffers
+   */
+  Buffers& buffers();
+
+  // Part const iterator, parts are rendered as a whole using their faces index range
+  using Citer = std::vector<Part>::const_iterator;
+
+  /**
+   * @brief Returns an iterator to the beginning of all parts
    * @return Begin iterator
    */
   Citer begin() const;
 
   /**
-   * @brief Returns an iterator to the end of all faces
+   * @brief Returns an iterator to the end of all parts
    * @return End iterator
    */
   Citer end() const;
 
 private:
 
+  /**
+   * @brief Add the triangle indices of a new face to the last added part, call before adding the
+   * face vertices
+   * @param is_quad Face is quad and is split in 2 triangles, else 1 triangle
+   */
+  void add_indices(bool is_quad);
+
+  /**
+   * @brief Mark a part as changed so that its world cs bounding box is updated on the next request,
+   * and the static parts hierarchy is rebuilt if the part is static
+   * @param part Part index
+   */
+  void mark_changed(int32_t part);
+
   // solid parts
   std::vector<Part> _parts;
   // solid faces
   std::vector<Face> _faces;
   // all vertices
   std::vector<Vertex> _vertices;
+  // triangle indices into vertices
+  std::vector<uint32_t> _indices;
+  // vertex data revision
+  int32_t _revision{0};
+  // render buffers
+  Buffers _buffers;
+  // world cs bounding boxes
+  Part_bounds _bounds;
+  // static part indices
+  std::vector<int32_t> _static;
+  // movable part indices
+  std::vector<int32_t> _movable;
+  // static parts hierarchy
+  ares::Bvh _bvh;
+  // static parts hierarchy is up to date
+  bool _bvh_valid{false};
+  // movable parts tree
+  ares::Dynamic_tree _movable_tree;
+  // movable parts tree proxies, one per part, -1 for static parts and parts without faces
+  std::vector<int32_t> _proxies;
 };
 
 
 
-inline void Solid_parts::add_part(Texture tex, const ares::dcs3& cs)
+inline void Solid_parts::add_part(Texture tex, const ares::dcs3& cs, bool movable)
 {
-  _parts.push_back({.tex = tex, .mat = ares::dmatrix::make_from(cs)});
+  const auto index = static_cast<int32_t>(_parts.size());
+  _parts.push_back(
+    {.tex = tex,
+     .mat = ares::dmatrix::make_from(cs),
+     .fbegin = static_cast<int32_t>(_faces.size()),
+     .ibegin = static_cast<int32_t>(_indices.size()),
+     .movable = movable});
+  _bounds.add_part();
+  _proxies.push_back(ares::Dynamic_tree::null);
+  (movable ? _movable : _static).push_back(index);
+  _bvh_valid = _bvh_valid && movable;
 }
 
 
@@ -117,7 +260,12 @@ inline void Solid_parts::add_face(
     {.part = static_cast<int32_t>(_parts.size()) - 1,
      .norm = normal,
      .is_quad = false,
-     .vbegin = static_cast<int32_t>(_vertices.size())});
+     .vbegin = static_cast<int32_t>(_vertices.size()),
+     .ibegin = static_cast<int32_t>(_indices.size())});
+  ++_parts.back().fcount;
+  add_indices(false);
+  _parts.back().bbox.extend({v0.pos, v1.pos, v2.pos});
+  mark_changed(static_cast<int32_t>(_parts.size()) - 1);
   _vertices.insert(_vertices.end(), {v0, v1, v2});
 }
 
@@ -130,98 +278,172 @@ inline void Solid_parts::add_face(
     {.part = static_cast<int32_t>(_parts.size()) - 1,
      .norm = normal,
      .is_quad = true,
-     .vbegin = static_cast<int32_t>(_vertices.size())});
+     .vbegin = static_cast<int32_t>(_vertices.size()),
+     .ibegin = static_cast<int32_t>(_indices.size())});
+  ++_parts.back().fcount;
+  add_indices(true);
+  _parts.back().bbox.extend({v0.pos, v1.pos, v2.pos, v3.pos});
+  mark_changed(static_cast<int32_t>(_parts.size()) - 1);
   _vertices.insert(_vertices.end(), {v0, v1, v2, v3});
 }
 
 
 
-inline Solid_parts::Part& Solid_parts::get_part(int index)
+inline void Solid_parts::set_matrix(int32_t part, const ares::dmatrix& mat)
 {
-  return _parts[index];
+  _parts[part].mat = mat;
+  mark_changed(part);
 }
 
 
 
-struct Solid_parts::Citer
+inline void Solid_parts::set_origin(int32_t part, const ares::dvec3& origin)
 {
-  // part begin iterator
-  std::vector<Part>::const_iterator pbegin;
-  // vertex begin iterator
-  std::vector<Vertex>::const_iterator vbegin;
-  // face iterator
-  std::vector<Face>::const_iterator face_it;
+  _parts[part].mat.set_origin(origin);
+  mark_changed(part);
+}
 
 
-  /**
-   * @brief Equality operator
-   * @param other Object to compare against
-   * @return Result of comparison
-   */
-  bool operator==(const Citer& other) const;
 
-  /**
-   * @brief Inequality operator
-   * @param other Object to compare against
-   * @return Result of comparison
-   */
-  bool operator!=(const Citer& other) const;
+inline std::span<const Solid_parts::Part> Solid_parts::parts() const
+{
+  return _parts;
+}
 
-  /**
-   * @brief Deref operator
-   * @return Face and vertices
-   */
-  std::tuple<const Part&, const Face&, std::span<const Vertex>> operator*();
 
-  /**
-   * @brief Increment operator
-   */
-  void operator++();
-};
 
+inline const ares::Bbox3_soa& Solid_parts::world_boxes()
+{
+  return _bounds.update<Part>(
+    _parts,
+    [this](int32_t part, const ares::Bbox3& box)
+    {
+      if (!_parts[part].movable || box.max.x < box.min.x)
+      {
+        return;
+      }
+
+      if (ares::Dynamic_tree::null == _proxies[part])
+      {
+        _proxies[part] = _movable_tree.insert(box, part);
+      }
+      else
+      {
+        _movable_tree.move(_proxies[part], box);
+      }
+    });
+}
 
 
-inline Solid_parts::Citer Solid_parts::begin() const
+
+inline std::span<const Solid_parts::Face> Solid_parts::faces() const
 {
-  return {.pbegin = _parts.begin(), .vbegin = _vertices.begin(), .face_it = _faces.begin()};
+  return _faces;
 }
 
 
 
-inline Solid_parts::Citer Solid_parts::end() const
+inline std::span<const Vertex> Solid_parts::vertices() const
 {
-  return {.pbegin = _parts.begin(), .vbegin = _vertices.begin(), .face_it = _faces.end()};
+  return _vertices;
 }
 
 
 
-inline bool Solid_parts::Citer::operator==(const Citer& other) const
+inline std::span<const uint32_t> Solid_parts::indices() const
 {
-  return face_it == other.face_it;
+  return _indices;
 }
 
 
 
-inline bool Solid_parts::Citer::operator!=(const Citer& other) const
+inline int32_t Solid_parts::revision() const
 {
-  return !(*this == other);
+  return _revision;
 }
 
 
 
-inline std::tuple<const Solid_parts::Part&, const Solid_parts::Face&, std::span<const Vertex>>
-Solid_parts::Citer::operator*()
+inline Buffers& Solid_parts::buffers()
 {
-  const auto part_it = pbegin + face_it->part;
-  const auto vert_it = vbegin + face_it->vbegin;
-  return {*part_it, *face_it, {vert_it, vert_it + 3 + face_it->is_quad}};
+  return _buffers;
 }
 
 
 
-inline void Solid_parts::Citer::operator++()
+inline std::span<const int32_t> Solid_parts::static_parts() const
+{
+  return _static;
+}
+
+
+
+inline std::span<const int32_t> Solid_parts::movable_parts() const
+{
+  return _movable;
+}
+
+
+
+inline const ares::Bvh& Solid_parts::static_bvh()
+{
+  if (!_bvh_valid)
+  {
+    const auto& boxes = world_boxes();
+    std::vector<ares::Bbox3> static_boxes;
+    static_boxes.reserve(_static.size());
+    for (const auto index : _static)
+    {
+      static_boxes.push_back(boxes.get(index));
+    }
+    _bvh.build(static_boxes);
+    _bvh_valid = true;
+  }
+  return _bvh;
+}
+
+
+
+inline const ares::Dynamic_tree& Solid_parts::movable_tree()
+{
+  world_boxes();
+  return _movable_tree;
+}
+
+
+
+inline void Solid_parts::add_indices(bool is_quad)
+{
+  const auto vbegin = static_cast<uint32_t>(_vertices.size());
+  _indices.insert(_indices.end(), {vbegin, vbegin + 1, vbegin + 2});
+  if (is_quad)
+  {
+    _indices.insert(_indices.end(), {vbegin, vbegin + 2, vbegin + 3});
+  }
+  _parts.back().icount = static_cast<int32_t>(_indices.size()) - _parts.back().ibegin;
+  ++_revision;
+}
+
+
+
+inline void Solid_parts::mark_changed(int32_t part)
+{
+  _bounds.mark_changed(part);
+  _bvh_valid = _bvh_valid && _parts[part].movable;
+}
+
+
+
+inline Solid_parts::Citer Solid_parts::begin() const
+{
+  return _parts.begin();
+}
+
+
+
+inline Solid_parts::Citer Solid_parts::end() const
 {
-  face_it++;
+  return _parts.end();
 }
 
 } // namespace hera
@@ -9,6 +9,7 @@
 namespace hera
 {
 
+// authoring vertex, converted to a packed layout when uploaded for rendering
 struct Vertex
 {
   // vertex position
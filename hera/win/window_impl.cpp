@@ -1,5 +1,7 @@
 #include "window_impl.h"
 
+#include "../opengl/heragl.h"
+
 namespace
 {
 
@@ -90,6 +92,19 @@ std::unique_ptr<Window::Impl> Window::Impl::make_impl(
     return nullptr;
   }
 
+  // load extensions (buffer objects, vertex arrays) for the current context
+  if (GLEW_OK != glewInit())
+  {
+    return nullptr;
+  }
+
+  // the renderer calls vertex arrays, framebuffers, instanced arrays and GLSL 1.30 shaders
+  // unconditionally, their entry points are null on older contexts
+  if (!GLEW_VERSION_3_3)
+  {
+    return nullptr;
+  }
+
   ShowWindow(w->wnd_handle, SW_SHOW);
   SetForegroundWindow(w->wnd_handle);
   SetFocus(w->wnd_handle);
@@ -5,6 +5,7 @@
 #include <hera/engine.h>
 #include <hera/image.h>
 #include <hera/opengl/heragl.h>
+#include <numbers>
 
 namespace
 {
@@ -16,11 +17,19 @@ namespace
 void add_piramid(hera::Solid_parts& solids);
 
 /**
- * @brief Add a colored cube
+ * @brief Add a colored cube as a movable part
  * @param solids Solid parts to add to
  */
 void add_cube(hera::Solid_parts& solids);
 
+/**
+ * @brief Add the faces of a colored cube
+ * @tparam P Parts type
+ * @param parts Parts to add to
+ */
+template <typename P>
+void add_cube_faces(P& parts);
+
 } // namespace
 
 
@@ -42,7 +51,7 @@ void Scene::resize(int32_t width, int32_t height)
   const double aspect = double(width) / height;
   hera::engine.renderer.set_perspective(false, 45, aspect, 0.1, 100);
   _camera.set_window_center(width / 2, height / 2);
-  _camera.set_perspective(45, aspect, 0.1, 100);
+  _camera.set_perspective(std::numbers::pi / 4, aspect, 0.1, 100);
 }
 
 
@@ -62,7 +71,7 @@ void Scene::load()
     img, hera::Texture::Min::Linear_mipmap_nearest, hera::Texture::Mag::Linear);
   const hera::Blend blend{.src = hera::Blend::Src_alpha, .dst = hera::Blend::One_minus_src_alpha};
 
-  _glassy.add_part(tex, blend, {.origin = {.z = -5}});
+  _glassy.add_part(tex, blend, {.origin = {.z = -5}}, true);
   _glassy.add_face(
     {.z = 1},
     {.pos = {.x = -1, .y = -1, .z = 1}, .tex = {.x = 0, .y = 1}},
@@ -103,6 +112,17 @@ void Scene::load()
   add_piramid(_solids);
   add_cube(_solids);
 
+  // floor of instanced cubes, the mesh is stored once for all of them
+  auto& cubes = _instanced.emplace_back();
+  add_cube_faces(cubes);
+  for (int32_t i = 0; i < 8; ++i)
+  {
+    for (int32_t j = 0; j < 8; ++j)
+    {
+      cubes.add_instance({.origin = {.x = -10.5 + 3 * i, .y = -4, .z = -8.0 - 3 * j}});
+    }
+  }
+
   _light = {
     .pos = {.z = 2},
     .ambient = {.r = 0.1, .g = 0.1, .b = 0.1, .a = 1},
@@ -131,6 +151,15 @@ void Scene::handle_keys(hera::Keymap& keys)
     hera::engine.renderer.use_lighting(_has_light);
   }
 
+  if (keys.is_pressed(Key::T))
+  {
+    keys.release(Key::T);
+    using Transparency = hera::Renderer::Transparency;
+    const bool is_sorted = Transparency::Sorted == hera::engine.renderer.transparency();
+    hera::engine.renderer.set_transparency(
+      is_sorted ? Transparency::Weighted_oit : Transparency::Sorted);
+  }
+
   const double move_speed = 0.005;
   if (keys.is_pressed(Key::E))
   {
@@ -201,7 +230,7 @@ void Scene::render()
   hera::engine.set_camera(_camera);
   hera::engine.renderer.set_light(_light);
 
-  glBindTexture(GL_TEXTURE_2D, 0);
+  hera::engine.renderer.bind_texture({});
   glBegin(GL_QUADS);
   glNormal3f(0, 0, 1);
   glColor4ub(255, 255, 255, 255);
@@ -211,11 +240,13 @@ void Scene::render()
   glVertex3d(0.5, -0.5, -13);
   glEnd();
 
-  auto& part = _solids.get_part(1);
-  part.mat.set_origin(_ani.position());
+  _solids.set_origin(1, _ani.position());
 
-  _glassy.sort_by_depth(_camera.cs().x_axis);
-  hera::engine.renderer.render_parts(_solids, _glassy);
+  if (hera::Renderer::Transparency::Sorted == hera::engine.renderer.transparency())
+  {
+    _glassy.sort_by_depth(_camera.cs().x_axis, hera::Glass_parts::Sort::Coherent);
+  }
+  hera::engine.renderer.render_parts(_solids, _instanced, _glassy);
   hera::engine.renderer.unset_light(_light);
 }
 
@@ -255,38 +286,46 @@ void add_piramid(hera::Solid_parts& solids)
 
 void add_cube(hera::Solid_parts& solids)
 {
-  solids.add_part({}, {.origin = {.x = 1.5, .y = 0, .z = -9}});
-  solids.add_face(
+  solids.add_part({}, {.origin = {.x = 1.5, .y = 0, .z = -9}}, true);
+  add_cube_faces(solids);
+}
+
+
+
+template <typename P>
+void add_cube_faces(P& parts)
+{
+  parts.add_face(
     {.y = 1},
     {.pos = {.x = 1, .y = 1, .z = -1}, .color = {.r = 0, .g = 255, .b = 0, .a = 255}},
     {.pos = {.x = -1, .y = 1, .z = -1}, .color = {.r = 0, .g = 255, .b = 0, .a = 255}},
     {.pos = {.x = -1, .y = 1, .z = 1}, .color = {.r = 0, .g = 255, .b = 0, .a = 255}},
     {.pos = {.x = 1, .y = 1, .z = 1}, .color = {.r = 0, .g = 255, .b = 0, .a = 255}});
-  solids.add_face(
+  parts.add_face(
     {.y = -1},
     {.pos = {.x = 1, .y = -1, .z = 1}, .color = {.r = 255, .g = 128, .b = 0, .a = 255}},
     {.pos = {.x = -1, .y = -1, .z = 1}, .color = {.r = 255, .g = 128, .b = 0, .a = 255}},
     {.pos = {.x = -1, .y = -1, .z = -1}, .color = {.r = 255, .g = 128, .b = 0, .a = 255}},
     {.pos = {.x = 1, .y = -1, .z = -1}, .color = {.r = 255, .g = 128, .b = 0, .a = 255}});
-  solids.add_face(
+  parts.add_face(
     {.z = 1},
     {.pos = {.x = 1, .y = 1, .z = 1}, .color = {.r = 255, .g = 0, .b = 0, .a = 255}},
     {.pos = {.x = -1, .y = 1, .z = 1}, .color = {.r = 255, .g = 0, .b = 0, .a = 255}},
     {.pos = {.x = -1, .y = -1, .z = 1}, .color = {.r = 255, .g = 0, .b = 0, .a = 255}},
     {.pos = {.x = 1, .y = -1, .z = 1}, .color = {.r = 255, .g = 0, .b = 0, .a = 255}});
-  solids.add_face(
+  parts.add_face(
     {.z = -1},
     {.pos = {.x = 1, .y = -1, .z = -1}, .color = {.r = 255, .g = 255, .b = 0, .a = 255}},
     {.pos = {.x = -1, .y = -1, .z = -1}, .color = {.r = 255, .g = 255, .b = 0, .a = 255}},
     {.pos = {.x = -1, .y = 1, .z = -1}, .color = {.r = 255, .g = 255, .b = 0, .a = 255}},
     {.pos = {.x = 1, .y = 1, .z = -1}, .color = {.r = 255, .g = 255, .b = 0, .a = 255}});
-  solids.add_face(
+  parts.add_face(
     {.x = -1},
     {.pos = {.x = -1, .y = 1, .z = 1}, .color = {.r = 0, .g = 0, .b = 255, .a = 255}},
     {.pos = {.x = -1, .y = 1, .z = -1}, .color = {.r = 0, .g = 0, .b = 255, .a = 255}},
     {.pos = {.x = -1, .y = -1, .z = -1}, .color = {.r = 0, .g = 0, .b = 255, .a = 255}},
     {.pos = {.x = -1, .y = -1, .z = 1}, .color = {.r = 0, .g = 0, .b = 255, .a = 255}});
-  solids.add_face(
+  parts.add_face(
     {.x = 1},
     {.pos = {.x = 1, .y = 1, .z = -1}, .color = {.r = 255, .g = 0, .b = 255, .a = 255}},
     {.pos = {.x = 1, .y = 1, .z = 1}, .color = {.r = 255, .g = 0, .b = 255, .a = 255}},
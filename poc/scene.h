@@ -4,10 +4,12 @@
 #include <cstdint>
 #include <hera/camera.h>
 #include <hera/glass_parts.h>
+#include <hera/instanced_parts.h>
 #include <hera/keymap.h>
 #include <hera/light.h>
 #include <hera/solid_parts.h>
 #include <hera/time/animation.h>
+#include <vector>
 
 namespace poc
 {
@@ -58,6 +60,7 @@ private:
   // object parts
   hera::Glass_parts _glassy;
   hera::Solid_parts _solids;
+  std::vector<hera::Instanced_parts> _instanced;
   // light
   bool _has_light{false};
   hera::Light _light;